@@ -24,14 +24,33 @@
 *		element will appear in. 
 */
 
+#define _POSIX_C_SOURCE 200809L	// clock_gettime(), rand_r(), pthread rwlocks
+#define _DEFAULT_SOURCE		// MAP_ANONYMOUS, MAP_HUGETLB, madvise()
+
 #include <stdlib.h>
+#include <stddef.h>
 #include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <stdint.h>
 #include <time.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#if defined(MAP_HUGETLB) && !defined(MAP_HUGE_SHIFT)
+#define MAP_HUGE_SHIFT 26
+#endif
 
 /* _sl_node Skip 
 * List node. A skip list node needs to be accessable from 4 directions. we need to
 * be able to go "forward" and "backward" within a sub list as well as "up" and 
-* "down" to travel between sublists. Each node also needs to hold data.
+* "down" to travel between sublists. Each node also needs to hold data. In 
+* multiset mode an l0 node also counts the equal elements it stands for, so 
+* repeated keys share one tower. Nodes above l0 stop after _data, at 
+* _SL_NODE_LINKS bytes, unless the list keeps a key on every level, so that
+* plain lists do not pay for the count and key on their upper levels.
 */
 
 struct _sl_node {
@@ -40,11 +59,169 @@ struct _sl_node {
 	struct _sl_node *_prev_layer;
 	struct _sl_node *_next_layer;
 	void *_data;
+	int _count;	// copies of _data held by an l0 node, always 1 outside multiset mode
+	unsigned int _key_length;	// bytes mode: length of the key, at most UINT_MAX
+	union {
+		long _deadline;	// TTL mode: expiry time the nodes are ordered by
+		double _agg;	// aggregate over the l0 nodes from here to _next_node
+		struct _sl_marker *_markers;	// intervals marked on this node
+		struct _sl_version *_versions;	// multi-version mode: newest version of the key
+		unsigned long long _prefix;	// bytes mode: first bytes of the key, see _bytes_prefix()
+	} _key;		// key kept in the node itself by the modes that need one
+};
+
+#define _SL_NODE_LINKS offsetof(struct _sl_node, _count)
+
+/* skip_list_monoid
+* Describes the aggregate kept by an augmented skip list: the value each 
+* element contributes, an associative combine function and its identity, such
+* as (+, 0) for sums or (min, +inf) for minimums.
+*/
+
+struct skip_list_monoid {
+	double identity;
+	double (*combine)(double, double);
+	double (*value)(void *data);
+};
+
+/* skip_list_bytes
+* A byte string key, the element type of lists made by skip_list_create_bytes().
+* Keys are ordered like memcmp(), and the first SKIP_LIST_BYTES_INLINE bytes and
+* the length are copied into the node so that most comparisons made while 
+* searching never read the key bytes themselves. An element may be any struct
+* that starts with a struct skip_list_bytes.
+*/
+
+#define SKIP_LIST_BYTES_INLINE 8
+
+struct skip_list_bytes {
+	const void *bytes;
+	size_t length;
+};
+
+/* skip_list_interval
+* A closed interval [lo, hi] kept by an interval skip list, together with the
+* item it was added for. The list owns it from skip_list_interval_insert() 
+* until skip_list_interval_remove().
+*/
+
+struct skip_list_interval {
+	void *lo;
+	void *hi;
+	void *item;
+};
+
+/* _sl_marker
+* Entry of the marker list kept by each node of an interval skip list. Edge 
+* markers name the intervals that span the link from the node to its 
+* _next_node; endpoint markers are only found on l0 and name the intervals 
+* that start or end at the node's key.
+*/
+
+enum _sl_mark {
+	_SL_MARK_EDGE,
+	_SL_MARK_LO,
+	_SL_MARK_HI
+};
+
+struct _sl_marker {
+	struct skip_list_interval *_interval;
+	struct _sl_marker *_next;
+	int _kind;
+};
+
+/* skip_list_snapshot
+* A point in the history of a multi-version skip list. A read at a snapshot 
+* sees, for every key, the newest version whose sequence number is not above
+* the snapshot's. The list keeps its snapshots oldest first until they are 
+* released, and keeps every version one of them can still see.
+*/
+
+struct skip_list_snapshot {
+	unsigned long long sequence;
+	int _refs;		// snapshots taken with nothing written in between
+	struct skip_list_snapshot *_prev;
+	struct skip_list_snapshot *_next;
+};
+
+/* _sl_version
+* One write to a key of a multi-version skip list. The versions of a key are
+* chained from its l0 node, newest first.
+*/
+
+struct _sl_version {
+	unsigned long long _sequence;
+	void *_value;
+	int _tombstone;		// the write deleted the key
+	struct _sl_version *_older;
+};
+
+/* skip_list_allocator
+* Where a skip list gets the memory for its nodes from. alloc returns size 
+* bytes suitably aligned for any node, or NULL when it is out of memory, and 
+* free gives back a block obtained from alloc together with its size, which 
+* lets arenas and pools skip a header per block. ctx is passed to both.
+*/
+
+struct skip_list_allocator {
+	void *(*alloc)(size_t size, void *ctx);
+	void (*free)(void *ptr, size_t size, void *ctx);
+	void *ctx;
+};
+
+/* _sl_filter
+* A counting Bloom filter in front of a skip list's lookups. The counters of
+* every element sit in one 64 byte block, two 4-bit counters per byte, so a 
+* lookup for an element that is not in the list is usually answered from a 
+* single cache line. Counters are decremented when elements leave, except 
+* those that reached 15, which stay there for good. Elements that leave 
+* without being counted out, by skip_list_split(), only make the filter 
+* answer "maybe" more often; it never misses an element that is in the list.
+*/
+
+#define _SL_FILTER_BLOCK 64	// bytes per block, 128 counters
+
+struct _sl_filter {
+	unsigned long long (*_hash)(void *);
+	unsigned char *_blocks;
+	size_t _block_count;
+	int _probes;		// counters set per element
+	int _bits;		// log2 of the inverse false positive rate
+	int _capacity;		// elements the blocks were sized for
+	int _count;		// elements counted in
+	unsigned long _queries;
+	unsigned long _negatives;	// lookups answered by the filter alone
+	unsigned long _false_positives;	// lookups the filter let through in vain
+};
+
+/* _sl_cache
+* A direct-mapped cache of l0 nodes in front of a skip list's lookups, 
+* indexed by the hash of their elements, so that a key looked up again is 
+* found without a search. A removed node is cleared from its slot; 
+* operations that move or free many nodes at once bump _generation instead,
+* which turns every entry filled before into a miss.
+*/
+
+struct _sl_cache_entry {
+	unsigned long long _hash;
+	unsigned long _generation;
+	struct _sl_node *_node;
+};
+
+struct _sl_cache {
+	unsigned long long (*_hash)(void *);
+	struct _sl_cache_entry *_entries;
+	unsigned long _mask;	// entries - 1, a power of two minus one
+	unsigned long _generation;
 };
 
 /* skip_list 
 * A Skip list needs a pointer to the head list, access to the comparison
-* function, and a size attribute that needs to be maintained. 
+* function, and a size attribute that needs to be maintained. Operations that
+* cut a list in O(log n) cannot know how many elements they moved, so they 
+* mark the size stale and skip_list_size() recounts it when it is next read.
+* The list also keeps both ends of l0 at hand so the smallest and largest 
+* elements can be reached without a search.
 *
 */
 
@@ -52,8 +229,303 @@ struct skip_list {
 	struct _sl_node *_first_node;
 	int (*_gt_func)(void *, void *);
 	int _size;
+	int _size_stale;	// _size must be recounted from l0 before it is read
+	int _multiset;		// elements are matched by key and counted
+	struct _sl_node *_base_node;	// header of l0
+	struct _sl_node *_last_node;	// last node of l0, NULL when empty
+	int _aggregate;		// nodes carry aggregates of _monoid
+	struct skip_list_monoid _monoid;
+	int _interval;		// nodes carry interval markers
+	int _bytes;		// elements are byte strings with inline prefixes
+	struct skip_list_allocator _allocator;	// source of nodes, markers and intervals
+	int _mvcc;		// l0 nodes carry version chains
+	unsigned long long _sequence;	// multi-version mode: sequence number of the last write
+	struct skip_list_snapshot *_snapshots;	// oldest snapshot, NULL if none
+	struct skip_list_snapshot *_newest_snapshot;
+	struct _sl_filter *_filter;	// membership filter in front of lookups, NULL if none
+	struct _sl_cache *_cache;	// hot node cache in front of lookups, NULL if none
+	size_t _node_size;	// bytes of a node above l0, _SL_NODE_LINKS or a whole node
+	unsigned int _seed;	// rand_r() state for the heights of new towers
+};
+
+/* skip_list_page_mode
+* The pages behind the nodes of a list. Only compact lists can ask for huge 
+* pages; every other list reports SKIP_LIST_PAGES_DEFAULT.
+*/
+
+enum skip_list_page_mode {
+	SKIP_LIST_PAGES_DEFAULT,	// regular pages from malloc() or mmap()
+	SKIP_LIST_PAGES_THP,		// transparent huge pages asked for with madvise()
+	SKIP_LIST_PAGES_HUGE_2M,	// 2MB hugetlbfs pages
+	SKIP_LIST_PAGES_HUGE_1G		// 1GB hugetlbfs pages
+};
+
+/* skip_list_stats
+* Structural statistics of a skip list, filled in by skip_list_stats(). Levels
+* are numbered from the base list "l0" upward, so a tower of height h has a
+* node on levels 0 through h - 1. Anything at or above SKIP_LIST_STATS_LEVELS
+* is counted in the last bucket. The search figures come from sampled probes 
+* for elements that are already in the list.
+*/
+
+#define SKIP_LIST_STATS_LEVELS 64
+#define SKIP_LIST_STATS_PROBES 64
+
+struct skip_list_stats {
+	int levels;		// number of sublists, including l0
+	int size;		// number of elements in l0
+	int height_histogram[SKIP_LIST_STATS_LEVELS];	// towers of height i + 1
+	int nodes_per_level[SKIP_LIST_STATS_LEVELS];	// nodes in level i, header excluded
+	size_t total_bytes;	// list structure, headers and every level's nodes
+	int probes;		// number of sampled searches
+	double avg_search_path;	// nodes visited per sampled search
+	int max_search_path;
+	double avg_comparisons;	// gt_func calls per sampled search
+	int page_mode;		// enum skip_list_page_mode of the nodes
+	unsigned long filter_queries;	// lookups that went through the filter
+	unsigned long filter_negatives;	// of those, answered by the filter alone
+	unsigned long filter_false_positives;	// of those, let through but not found
+};
+
+/* skip_list_hook
+* The links of an element of an intrusive skip list, embedded in the element
+* itself. The forward links of the lowest SKIP_LIST_HOOK_INLINE levels live in
+* the hook and the few taller towers keep the rest in an array the list 
+* allocates. The hook belongs to the list while the element is in it.
+*/
+
+#define SKIP_LIST_HOOK_INLINE 4
+#define SKIP_LIST_HOOK_LEVELS 64
+
+struct skip_list_hook {
+	struct skip_list_hook *_prev;	// previous element on l0, NULL for the first
+	struct skip_list_hook **_tower;	// links above the inline ones, NULL if none
+	int _height;
+	struct skip_list_hook *_next[SKIP_LIST_HOOK_INLINE];
+};
+
+/* skip_list_intrusive
+* A skip list whose elements carry their own links in a struct skip_list_hook,
+* found at the same offset in every element.
+*/
+
+struct skip_list_intrusive {
+	int (*_gt_func)(void *, void *);
+	size_t _offset;		// of the hook inside an element
+	int _size;
+	int _levels;
+	struct skip_list_hook *_head[SKIP_LIST_HOOK_LEVELS];	// first hook of every level
+	struct skip_list_hook *_last;	// last hook of l0, NULL when empty
+	unsigned int _seed;	// rand_r() state for the heights of new towers
+};
+
+/* skip_list_compact
+* A skip list whose nodes link to each other by 32-bit indices into an arena
+* owned by the list instead of by pointers. The arena grows in chunks of 
+* 2^_shift nodes that never move, so index i is node i % 2^_shift of chunk
+* i / 2^_shift. Index 0 
+* stands for NULL, and freed nodes are chained through _next_node for reuse.
+* A chunk of 2^18 nodes is 6MB, three 2MB pages; lists on 1GB pages use 
+* chunks of 2^27 nodes, three 1GB pages.
+*/
+
+#define SKIP_LIST_COMPACT_SHIFT 18
+#define SKIP_LIST_COMPACT_SHIFT_1G 27
+
+struct _sl_cnode {
+	uint32_t _prev_node;
+	uint32_t _next_node;
+	uint32_t _prev_layer;
+	uint32_t _next_layer;
+	void *_data;
+};
+
+struct skip_list_compact {
+	int (*_gt_func)(void *, void *);
+	struct _sl_cnode **_chunks;	// base pointer of every chunk
+	uint32_t _chunk_count;
+	uint32_t _used;		// highest index handed out
+	uint32_t _limit;	// highest index the arena may hand out
+	uint32_t _free;		// first freed node, 0 if none
+	uint32_t _first_node;	// header of the top sublist
+	int _size;
+	int _shift;		// log2 of the nodes per chunk
+	int _mapped;		// chunks come from mmap() instead of malloc()
+	int _page_mode;		// weakest page mode any chunk got
+	unsigned int _seed;	// rand_r() state for the heights of new towers
+};
+
+/* skip_list_spray
+* A relaxed priority queue shared by many threads, after the SprayList. 
+* Instead of all fighting over the first node, every delete_min takes a short
+* random walk ("spray") down from the upper levels and claims whichever node it
+* lands on. Claims only decrement the node's count atomically under a shared
+* lock; claimed nodes are unlinked in batches under the exclusive lock.
+*/
+
+struct skip_list_spray {
+	struct skip_list *_sl;
+	pthread_rwlock_t _lock;
+	int _height;		// level the spray starts from
+	int _jump;		// longest step taken on each level
+	int _claimed;		// nodes emptied by claims but still linked
+	int _cleanup;		// _claimed at which the batch is unlinked
+};
+
+/* skip_list_replicated
+* A read-mostly skip list for machines with several NUMA nodes. Every node 
+* gets its own copy of the sparse upper levels, in memory local to it, whose
+* lowest copied level links down into the shared bottom levels, so a lookup
+* only leaves its node for the last few steps. Writers never touch the 
+* copies; they bump _epoch, and lookups on a node whose copy is from an older
+* epoch use the shared levels. Once as many of them have done so as the old 
+* copy had nodes, the next one rebuilds the copy, so a list that is written
+* between every few lookups is not copied again after every write.
+*/
+
+struct _sl_replica {
+	struct _sl_node *_first_node;	// header of the top copied sublist
+	size_t _length;			// bytes mapped for the copy
+};
+
+struct skip_list_replicated {
+	struct skip_list *_sl;
+	pthread_rwlock_t _lock;
+	int _nodes;		// NUMA nodes, one replica each
+	int _shared_levels;	// bottom levels that are not copied
+	long _epoch;		// bumped by every write
+	struct _sl_replica **_replicas;	// current copy of every node, NULL if none
+	long *_replica_epochs;	// epoch of every node's copy, published after it
+	long *_stale_lookups;	// lookups on every node since its copy went stale
+	long *_rebuild_after;	// stale lookups every node waits for, its copy's nodes
+	int *_building;		// set while a node's copy is being rebuilt
+};
+
+/* skip_list_sharded
+* A skip list partitioned by key range into independent shards, each with its
+* own lock, so writers to different ranges never wait for each other. A 
+* small routing table keeps the least key of every shard. A shard that grows
+* past _split_size is split at its middle, and one that shrinks below 
+* _merge_size is joined to a neighbour, both under the table's exclusive lock.
+*/
+
+struct _sl_shard {
+	struct skip_list *_sl;
+	pthread_rwlock_t _lock;
+	void *_lo;		// least key routed to the shard, unused for the first
+};
+
+struct skip_list_sharded {
+	int (*_gt_func)(void *, void *);
+	pthread_rwlock_t _lock;	// shared to route, exclusive to split or merge
+	struct _sl_shard **_shards;	// in key order
+	int _count;
+	int _capacity;
+	int _split_size;
+	int _merge_size;
+};
+
+/* Instrumentation
+* Building with -DSKIP_LIST_INSTRUMENT makes the private functions count the 
+* work they do and samples the latency of insert, remove and contains into an
+* HDR-style histogram. Counters and histograms are kept per thread, so they
+* need no locking and describe the traffic of the thread that reads them. 
+* Without the flag every hook below expands to nothing.
+*
+* Latencies are recorded in nanoseconds. Values below 16 get one bucket each;
+* above that every power of two is split into 16 linear sub-buckets, which
+* keeps the relative error of a recorded value under 6.25%.
+*/
+
+#ifdef SKIP_LIST_INSTRUMENT
+
+#ifndef SKIP_LIST_LATENCY_SAMPLE
+#define SKIP_LIST_LATENCY_SAMPLE 16	// time one operation in this many, power of 2
+#endif
+
+#define SKIP_LIST_LATENCY_BUCKETS ((64 - 3) * 16)
+
+enum skip_list_op {
+	SKIP_LIST_OP_INSERT,
+	SKIP_LIST_OP_REMOVE,
+	SKIP_LIST_OP_CONTAINS,
+	SKIP_LIST_OPS
 };
 
+struct skip_list_counters {
+	unsigned long nodes_visited;	// forward steps taken while searching
+	unsigned long levels_descended;	// steps down to a lower sublist
+	unsigned long comparisons;	// calls to gt_func
+	unsigned long allocations;	// nodes and lists allocated
+	unsigned long frees;		// nodes and lists freed
+	unsigned long replica_lookups;	// lookups that started from a NUMA replica
+	unsigned long operations[SKIP_LIST_OPS];
+	unsigned long samples[SKIP_LIST_OPS];
+	unsigned long latency[SKIP_LIST_OPS][SKIP_LIST_LATENCY_BUCKETS];
+};
+
+static _Thread_local struct skip_list_counters _sl_counters;
+
+#define _SL_COUNT(counter) ((void)++(_sl_counters.counter))
+#define _SL_GT(gt_func, a, b) (_SL_COUNT(comparisons), (gt_func)((a), (b)))
+#define _SL_LATENCY_BEGIN(op) struct timespec _sl_start; \
+	int _sl_sampled = _sl_latency_begin((op), &_sl_start)
+#define _SL_LATENCY_END(op) if(_sl_sampled) { _sl_latency_end((op), &_sl_start); }
+
+/*
+* This private function maps a latency in nanoseconds to its histogram bucket.
+*/
+int _sl_latency_bucket(unsigned long long nanoseconds) {
+	int msb;
+
+	if(nanoseconds < 16) {
+		return (int)nanoseconds;
+	}
+
+	msb = 63 - __builtin_clzll(nanoseconds);
+	return (msb - 3) * 16 + (int)((nanoseconds >> (msb - 4)) & 15);
+}
+
+/*
+* This private function counts an operation and starts its clock if the 
+* operation was picked as a sample. Returns 1 if it was sampled, 0 otherwise.
+*/
+int _sl_latency_begin(int op, struct timespec *start) {
+	if((_sl_counters.operations[op]++) & (SKIP_LIST_LATENCY_SAMPLE - 1)) {
+		return 0;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, start);
+	return 1;
+}
+
+/*
+* This private function stops the clock of a sampled operation and records the
+* elapsed time in the operation's histogram.
+*/
+void _sl_latency_end(int op, struct timespec *start) {
+	struct timespec end;
+	long long elapsed;
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	elapsed = (end.tv_sec - start->tv_sec) * 1000000000LL + (end.tv_nsec - start->tv_nsec);
+	if(elapsed < 0) {
+		elapsed = 0;
+	}
+
+	++(_sl_counters.latency[op][_sl_latency_bucket((unsigned long long)elapsed)]);
+	++(_sl_counters.samples[op]);
+}
+
+#else
+
+#define _SL_COUNT(counter) ((void)0)
+#define _SL_GT(gt_func, a, b) (gt_func)((a), (b))
+#define _SL_LATENCY_BEGIN(op)
+#define _SL_LATENCY_END(op)
+
+#endif
+
 /*private functions*/
 
 /* _coin_flip 
@@ -61,11 +533,215 @@ struct skip_list {
 * determine if an added element will appear in subsequent sublists. If the coin
 * flip returns a 1 "heads" the element will be added to the next sublist. If
 * the coin flip returns a 0 "tails", the element will not be added to any other
-8* sublists. 
+8* sublists. Every list flips with rand_r() on a seed of its own, so lists 
+* written by different threads neither contend on the lock behind rand() nor
+* share one sequence of heights.
+*/
+
+int _coin_flip(unsigned int *seed) {
+	return rand_r(seed) % 2;
+}
+
+/*
+* This private function returns a seed for a new list's _coin_flip(). A 
+* process wide counter keeps the seeds of lists made in the same second apart.
+*/
+unsigned int _seed_new(void) {
+	static unsigned int lists;
+	unsigned int count = __atomic_add_fetch(&lists, 1, __ATOMIC_RELAXED);
+
+	return (unsigned int)time(NULL) ^ (count * 2654435761u);
+}
+
+/*
+* These private functions are the allocator of lists that were not given one.
+*/
+void *_default_alloc(size_t size, void *ctx) {
+	(void)ctx;
+	return malloc(size);
+}
+
+void _default_free(void *ptr, size_t size, void *ctx) {
+	(void)size;
+	(void)ctx;
+	free(ptr);
+}
+
+/*
+* This private function allocates size bytes for a list from its allocator.
+*/
+void *_sl_alloc(struct skip_list *sl, size_t size) {
+	_SL_COUNT(allocations);
+	return sl->_allocator.alloc(size, sl->_allocator.ctx);
+}
+
+/*
+* This private function returns a block allocated by _sl_alloc() to the 
+* list's allocator.
+*/
+void _sl_free(struct skip_list *sl, void *ptr, size_t size) {
+	_SL_COUNT(frees);
+	sl->_allocator.free(ptr, size, sl->_allocator.ctx);
+}
+
+/*
+* This private function allocates a node of a tower and fills in what every
+* node holds. below is the node under the new one, NULL on l0; only whole 
+* nodes get a count and an empty key.
+*/
+struct _sl_node *_node_alloc(struct skip_list *sl, struct _sl_node *below, void *data) {
+	size_t size = below ? sl->_node_size : sizeof(struct _sl_node);
+	struct _sl_node *new_node = (struct _sl_node *)_sl_alloc(sl, size);
+
+	if(!new_node) {
+		return NULL;
+	}
+	new_node->_prev_layer = NULL;
+	new_node->_next_layer = below;
+	new_node->_data = data;
+	if(size == sizeof(struct _sl_node)) {
+		new_node->_count = 1;
+		new_node->_key._markers = NULL;	// filled in by the modes that keep a key
+	}
+
+	return new_node;
+}
+
+/*
+* This private function returns the size a node was allocated with: headers 
+* and l0 nodes are whole, the others are _node_size bytes. Only the node's own
+* links are read, so it can size a node whose neighbours are already freed.
+*/
+size_t _node_bytes(struct skip_list *sl, struct _sl_node *node) {
+	return node->_prev_node && node->_next_layer ? sl->_node_size : sizeof(struct _sl_node);
+}
+
+/*
+* This private function hashes an element for a filter or cache with the 
+* hash function it was given, or the pointer if none, and mixes the result 
+* so that weak hashes such as the pointer itself still spread evenly.
+*/
+unsigned long long _hash_element(unsigned long long (*hash_func)(void *), void *data) {
+	unsigned long long hash = hash_func ? hash_func(data) : (unsigned long long)(uintptr_t)data;
+
+	hash ^= hash >> 30;
+	hash *= 0xbf58476d1ce4e5b9ULL;
+	hash ^= hash >> 27;
+	hash *= 0x94d049bb133111ebULL;
+	hash ^= hash >> 31;
+
+	return hash;
+}
+
+/*
+* This private function adds delta, 1 or -1, to the counters of data, or 
+* with delta 0 checks whether they are all set. The block comes from the 
+* high bits of the hash and the counters in it from the low ones, stepping 
+* by an odd stride so they are all different.
+*
+* Returns:
+*	int - returns 0 if data is certainly not in the list, 1 otherwise
+*/
+int _filter_update(struct _sl_filter *filter, void *data, int delta) {
+	unsigned long long hash = _hash_element(filter->_hash, data);
+	unsigned char *block = &(filter->_blocks[(size_t)(((hash >> 32) * filter->_block_count) >> 32) * _SL_FILTER_BLOCK]);
+	unsigned int slot = hash & 127;
+	unsigned int stride = ((hash >> 7) & 127) | 1;
+	unsigned int shift;
+	unsigned int counter;
+
+	for(int probe = 0; probe < filter->_probes; ++probe, slot = (slot + stride) & 127) {
+		shift = (slot & 1) * 4;
+		counter = (block[slot >> 1] >> shift) & 15;
+		if(!delta && !counter) {
+			return 0;
+		}
+		if(delta > 0 && counter < 15) {
+			block[slot >> 1] += 1 << shift;
+		} else if(delta < 0 && counter > 0 && counter < 15) {
+			block[slot >> 1] -= 1 << shift;
+		}
+	}
+
+	return 1;
+}
+
+/*
+* This private function sizes a list's filter for capacity elements, or for
+* the next power of two times that above the size of l0, and counts in 
+* every element of l0. The filter is left as it was if the new 
+* blocks cannot be allocated.
+*
+* Returns:
+*	int - returns 1 if the filter was rebuilt, 0 otherwise
+*/
+int _filter_build(struct skip_list *sl, int capacity) {
+	struct _sl_filter *filter = sl->_filter;
+	struct _sl_node *current_node;
+	unsigned char *blocks;
+	size_t block_count;
+	int nodes = 0;
+
+	for(current_node = sl->_base_node->_next_node; current_node; current_node = current_node->_next_node) {
+		++nodes;
+	}
+	while(capacity < nodes) {
+		capacity *= 2;
+	}
+
+	// 1.5 counters per element for every halving of the false positive rate
+	block_count = ((size_t)capacity * (3 * filter->_bits) / 2 + 127) / 128;
+	if(!block_count) {
+		block_count = 1;
+	}
+	blocks = (unsigned char *)aligned_alloc(_SL_FILTER_BLOCK, block_count * _SL_FILTER_BLOCK);
+	if(!blocks) {
+		return 0;
+	}
+	memset(blocks, 0, block_count * _SL_FILTER_BLOCK);
+
+	free(filter->_blocks);
+	filter->_blocks = blocks;
+	filter->_block_count = block_count;
+	filter->_capacity = capacity;
+	filter->_count = 0;
+	for(current_node = sl->_base_node->_next_node; current_node; current_node = current_node->_next_node) {
+		_filter_update(filter, current_node->_data, 1);
+		++(filter->_count);
+	}
+
+	return 1;
+}
+
+/*
+* These private functions count an element of l0 in or out of a list's 
+* filter. The filter is rebuilt twice as large when it holds more elements 
+* than it was sized for, so the false positive rate stays as asked.
 */
+void _filter_add(struct skip_list *sl, void *data) {
+	struct _sl_filter *filter = sl->_filter;
+
+	if(filter->_count >= filter->_capacity && _filter_build(sl, 2 * filter->_capacity)) {
+		return;	// the rebuild counted data in with the rest of l0
+	}
+	_filter_update(filter, data, 1);
+	++(filter->_count);
+}
+
+void _filter_remove(struct skip_list *sl, void *data) {
+	_filter_update(sl->_filter, data, -1);
+	--(sl->_filter->_count);
+}
 
-int _coin_flip() {
-	return rand() % 2;
+/*
+* This private function recounts a list's filter, if it has one, after its 
+* nodes were moved in or out wholesale by skip_list_merge() or 
+* skip_list_concat(), which makes those O(n) for filtered lists.
+*/
+void _filter_refresh(struct skip_list *sl) {
+	if(sl->_filter) {
+		_filter_build(sl, sl->_filter->_capacity);
+	}
 }
 
 /* 
@@ -94,8 +770,9 @@ struct _sl_node *_find_previous( int (*gt_func)(void *, void *),
 	temp_node = current_node;
 	
 	//searches sublist
-	while(temp_node->_next_node && gt_func(data, temp_node->_next_node->_data)) {
+	while(temp_node->_next_node && _SL_GT(gt_func, data, temp_node->_next_node->_data)) {
 		temp_node = temp_node->_next_node;
+		_SL_COUNT(nodes_visited);
 	}
 
 	// if l0 has not been reached, go to next sublist
@@ -103,6 +780,7 @@ struct _sl_node *_find_previous( int (*gt_func)(void *, void *),
 		return temp_node;
 	}
 
+	_SL_COUNT(levels_descended);
 	return _find_previous(gt_func, temp_node->_next_layer, data);   
 }     
 /*
@@ -130,67 +808,190 @@ struct _sl_node *_find_node( int (*gt_func)(void *, void *),
 }
 
 /*
-* This private function deletes a specific node from the list, including all 
-* the sublists using a recursive function. The algorithm starts from the base 
-* list "l0", that contains all the nodes to go up. Because the pointer to the 
-* exact node to be deleted is provided, we rearange the pointers of any nodes 
-* connected to the deleted node and free the deleted node. 
-* 
-* Arguments: 
-*	struct _sl_node *current_node - pointer to the node containing the data
-*		that needs to be deleted
+* This private function orders two byte string keys like memcmp(), a key that
+* is a prefix of the other being the smaller one. It is the gt_func of lists
+* made by skip_list_create_bytes().
 */
+int _bytes_gt(void *a, void *b) {
+	struct skip_list_bytes *key_a = (struct skip_list_bytes *)a;
+	struct skip_list_bytes *key_b = (struct skip_list_bytes *)b;
+	int order;
 
-void _delete_node(struct _sl_node *del_sl_node) {
-	struct _sl_node *temp_prev_node;
-
-	if(!del_sl_node) {
-		return;
+	order = memcmp(key_a->bytes, key_b->bytes, key_a->length < key_b->length ? key_a->length : key_b->length);
+	if(order) {
+		return order > 0;
 	}
 
-	_delete_node(del_sl_node->_prev_layer);	//recursive call
+	return key_a->length > key_b->length;
+}
 
-	temp_prev_node = del_sl_node->_prev_node; // set a temp pointer to previous node 
-	temp_prev_node->_next_node = del_sl_node->_next_node; // set _next_node of temp node to the delete node's _next_node. Will set the next pointer to null if delete_node has no _next_node
-	
-	if(del_sl_node->_next_node) { // if there is a next node, it's previous pointer needs to be maintained.
-		del_sl_node->_next_node->_prev_node = temp_prev_node;
+/*
+* This private function packs the first bytes of a key into an integer, the 
+* first byte most significant and missing bytes zero, so that comparing two 
+* prefixes as integers orders them like memcmp() does.
+*/
+unsigned long long _bytes_prefix(struct skip_list_bytes *key) {
+	const unsigned char *bytes = (const unsigned char *)key->bytes;
+	unsigned long long prefix = 0;
+	size_t i;
+
+	for(i = 0; i < SKIP_LIST_BYTES_INLINE; ++i) {
+		prefix = (prefix << 8) | (i < key->length ? bytes[i] : 0);
 	}
-  
-	free(del_sl_node); //deallocate memory
+
+	return prefix;
 }
 
-/* 
-* This private function inserts a new node into the list, including all 
-* the sublists using a recursive function. Using the previous node pointer we 
-* can allocate space for the new node and rearange pointers to connect to the 
-* new node. We then use the _coin_flip() to determine how tall the new node's 
-* column will be.(how many sublists contain the new node and if we need to 
-* create new sublists). This is a recursive function. 
-*
-* Arguments: 
-*	struct _sl_node *prev_node - pointer to the node containing the data
-*		that needs to be inserted
-*	struct _sl_node *next_layer - pointer to the next sub list.
-*	void *data - poiner to data that needs to be in the new node.
+/*
+* This private function checks whether a key is greater than the key of a node
+* in a byte string list. Keys that differ in their inline prefix, or that fit 
+* in it, are told apart without reading the node's key bytes.
 *
+* Arguments:
+*	struct skip_list_bytes *key - key being searched for
+*	unsigned long long prefix - inline prefix of key
+*	struct _sl_node *node - node holding the other key
 * Return:
-*	struct _sl_node * - returns a pointer to the newset node to be used 
-*		when determining height of the new node's colomn.	
+*	int - returns 1 if key is greater, 0 otherwise
 */
+int _bytes_gt_node(struct skip_list_bytes *key, unsigned long long prefix, struct _sl_node *node) {
+	if(prefix != node->_key._prefix) {
+		return prefix > node->_key._prefix;
+	}
 
-struct _sl_node *_insert_node(struct _sl_node *prev_node, struct _sl_node *next_layer, void *data) {
-	struct _sl_node *new_node; 
-	struct _sl_node *new_layer;
-	struct _sl_node *temp_node;
-	
+	// equal prefixes: the shorter key is a prefix of the longer one
+	if(key->length < SKIP_LIST_BYTES_INLINE || node->_key_length < SKIP_LIST_BYTES_INLINE) {
+		return key->length > node->_key_length;
+	}
+
+	return _bytes_gt(key, node->_data);
+}
+
+/*
+* This private function is _find_previous() for byte string lists: the prefix
+* of the key is packed once and most steps compare it with the prefix held in
+* the node instead of following _data.
+*
+* Arguments:
+*	struct _sl_node *current_node - head node of the top sublist
+*	void *data - pointer to the struct skip_list_bytes searched for
+* Returns:
+*	struct _sl_node * - last l0 node whose key is less than the key of data
+*/
+struct _sl_node *_find_previous_bytes(struct _sl_node *current_node, void *data) {
+	struct skip_list_bytes *key = (struct skip_list_bytes *)data;
+	unsigned long long prefix = _bytes_prefix(key);
+
+	for(;;) {
+		while(current_node->_next_node && (_SL_COUNT(comparisons), _bytes_gt_node(key, prefix, current_node->_next_node))) {
+			current_node = current_node->_next_node;
+			_SL_COUNT(nodes_visited);
+		}
+		if(!(current_node->_next_layer)) {
+			return current_node;
+		}
+		current_node = current_node->_next_layer;
+		_SL_COUNT(levels_descended);
+	}
+}
+
+/*
+* This private function stores the inline prefix and length of a new node's 
+* key in every node of its tower.
+*/
+void _bytes_tag(struct _sl_node *node) {
+	struct skip_list_bytes *key = (struct skip_list_bytes *)node->_data;
+	unsigned long long prefix = _bytes_prefix(key);
+	unsigned int length = key->length < UINT_MAX ? (unsigned int)key->length : UINT_MAX;
+
+	for(; node; node = node->_prev_layer) {
+		node->_key._prefix = prefix;
+		node->_key_length = length;
+	}
+}
+
+/*
+* This private function returns the l0 node before the first element that is 
+* not less than data, searching the way the list's mode calls for.
+*
+* Arguments:
+*	struct skip_list *sl - pointer to skip list
+*	void *data - pointer to the data we are searching for
+*/
+struct _sl_node *_search(struct skip_list *sl, void *data) {
+	if(sl->_bytes) {
+		return _find_previous_bytes(sl->_first_node, data);
+	}
+
+	return _find_previous(sl->_gt_func, sl->_first_node, data);
+}
+
+/*
+* This private function deletes a specific node from the list, including all 
+* the sublists using a recursive function. The algorithm starts from the base 
+* list "l0", that contains all the nodes to go up. Because the pointer to the 
+* exact node to be deleted is provided, we rearange the pointers of any nodes 
+* connected to the deleted node and free the deleted node. 
+* 
+* Arguments: 
+*	struct skip_list *sl - pointer to skip list the node belongs to
+*	struct _sl_node *current_node - pointer to the node containing the data
+*		that needs to be deleted
+*/
+
+void _delete_node(struct skip_list *sl, struct _sl_node *del_sl_node) {
+	struct _sl_node *temp_prev_node;
+
+	if(!del_sl_node) {
+		return;
+	}
+
+	_delete_node(sl, del_sl_node->_prev_layer);	//recursive call
+
+	temp_prev_node = del_sl_node->_prev_node; // set a temp pointer to previous node 
+	temp_prev_node->_next_node = del_sl_node->_next_node; // set _next_node of temp node to the delete node's _next_node. Will set the next pointer to null if delete_node has no _next_node
+	
+	if(del_sl_node->_next_node) { // if there is a next node, it's previous pointer needs to be maintained.
+		del_sl_node->_next_node->_prev_node = temp_prev_node;
+	}
+  
+	_sl_free(sl, del_sl_node, _node_bytes(sl, del_sl_node)); //deallocate memory
+}
+
+/* 
+* This private function inserts a new node into the list, including all 
+* the sublists using a recursive function. Using the previous node pointer we 
+* can allocate space for the new node and rearange pointers to connect to the 
+* new node. We then use the _coin_flip() to determine how tall the new node's 
+* column will be.(how many sublists contain the new node and if we need to 
+* create new sublists). This is a recursive function. If the allocator runs 
+* out of memory above l0 the column simply stops growing there.
+*
+* Arguments: 
+*	struct skip_list *sl - pointer to skip list the node is added to
+*	struct _sl_node *prev_node - pointer to the node containing the data
+*		that needs to be inserted
+*	struct _sl_node *next_layer - pointer to the next sub list.
+*	void *data - poiner to data that needs to be in the new node.
+*
+* Return:
+*	struct _sl_node * - returns a pointer to the newset node to be used 
+*		when determining height of the new node's colomn, NULL if it 
+*		could not be allocated.
+*/
+
+struct _sl_node *_insert_node(struct skip_list *sl, struct _sl_node *prev_node, struct _sl_node *next_layer, void *data) {
+	struct _sl_node *new_node; 
+	struct _sl_node *new_layer;
+	struct _sl_node *temp_node;
+	
 	//initialize variables
-	new_node = (struct _sl_node *)malloc(sizeof(struct _sl_node));
+	new_node = _node_alloc(sl, next_layer, data);
+	if(!new_node) {
+		return NULL;
+	}
 	new_node->_prev_node = prev_node;
 	new_node->_next_node = prev_node->_next_node;
-	new_node->_prev_layer = NULL;
-	new_node->_next_layer = next_layer;
-	new_node->_data = data;
 
 	prev_node->_next_node = new_node;
     	
@@ -200,19 +1001,24 @@ struct _sl_node *_insert_node(struct _sl_node *prev_node, struct _sl_node *next_
     	}
 	
 	//check if node should be added to next sublist 
-	if(_coin_flip()) {
+	if(_coin_flip(&(sl->_seed))) {
 		temp_node = prev_node; 
 		
 		while(!(temp_node->_prev_layer)) {
 			if(!(temp_node->_prev_node)) {
 				
 				// initilizing new node
-				new_layer = (struct _sl_node *)malloc(sizeof(struct _sl_node));
+				new_layer = (struct _sl_node *)_sl_alloc(sl, sizeof(struct _sl_node));
+				if(!new_layer) {
+					return new_node;
+				}
 				new_layer->_prev_node = NULL;
 				new_layer->_next_node = temp_node->_next_node;
 				new_layer->_prev_layer = temp_node;
 				new_layer->_next_layer = temp_node->_next_layer;
 				new_layer->_data = NULL;
+				new_layer->_count = 0;
+				new_layer->_key = temp_node->_key;	// takes over temp_node's sublist
 				 
 				if(temp_node->_next_node) {
 					temp_node->_next_node->_prev_node = new_layer;
@@ -232,7 +1038,7 @@ struct _sl_node *_insert_node(struct _sl_node *prev_node, struct _sl_node *next_
 		}
 		
 		temp_node = temp_node->_prev_layer;
-		new_node->_prev_layer = _insert_node(temp_node, new_node, data);
+		new_node->_prev_layer = _insert_node(sl, temp_node, new_node, data);
 	}
 	
 	return new_node;
@@ -241,11 +1047,12 @@ struct _sl_node *_insert_node(struct _sl_node *prev_node, struct _sl_node *next_
 /* 
 * This private function reduces the height of the sublists after deleting a node;
 * Arguments: 
+*	struct skip_list *sl - pointer to skip list the sublists belong to
 *	_sl_node * head_node - the head node of a sublist which is always NULL
 * Return:
 *	_sl_node * - returns head node of a sub list that should be deleted.
 */
-struct _sl_node *_reduce_height(struct _sl_node *head_node) {
+struct _sl_node *_reduce_height(struct skip_list *sl, struct _sl_node *head_node) {
 	struct _sl_node *temp_next_layer;
 
 	if(!(head_node->_next_layer) || (head_node->_next_node)) {
@@ -253,241 +1060,6908 @@ struct _sl_node *_reduce_height(struct _sl_node *head_node) {
 	}
 
 	temp_next_layer = head_node->_next_layer;
-	free(head_node);  	
+	_sl_free(sl, head_node, sizeof(struct _sl_node));
 	temp_next_layer->_prev_layer = NULL;
 	
-	return _reduce_height(temp_next_layer);
+	return _reduce_height(sl, temp_next_layer);
 }
 /*
-* This private function deallocates the memeory used for the skip list using a
-* recursive function. 
+* This private function deallocates the memeory used for the skip list, one 
+* sublist at a time from the top, freeing every node along its links. It 
+* runs in constant stack space however long the list is.
 * 
 * Arguments:
-* 	struct _sl_node *current_node - first node of the skiplist that needs
+*	struct skip_list *sl - pointer to skip list the nodes belong to
+* 	struct _sl_node *current_node - head node of the top sublist that needs
 *		to be deleted.
 */
-void _delete_skip_list(struct _sl_node *current_node) {
-	if(!current_node) {
-		return;
-	}
-
-	_delete_skip_list(current_node->_next_layer);
-	_delete_skip_list(current_node->_next_node);
+void _delete_skip_list(struct skip_list *sl, struct _sl_node *current_node) {
+	struct _sl_node *next_layer;
+	struct _sl_node *next_node;
 
-	if(current_node->_prev_layer){
-		current_node->_prev_layer->_next_layer = NULL;
+	while(current_node) {
+		next_layer = current_node->_next_layer;
+		while(current_node) {
+			next_node = current_node->_next_node;
+			_sl_free(sl, current_node, _node_bytes(sl, current_node));
+			current_node = next_node;
+		}
+		current_node = next_layer;
 	}
-	free(current_node);
 }
 
-/*public functions - construction and destruction functions*/
-
-//constructor
-
 /*
-* public function that initializes a new skip list
-* 
+* This private function counts the sublists of a skip list, including l0.
+*
 * Arguments:
-* 	int (*gt_func)(void *, void *) - pointer to the greater than function
-*		to be used when initilizing a skip list
+*	struct _sl_node *head_node - head node of the top sublist
 * Return:
-	struct skip_list * - pointer to a new skip list 
+*	int - number of sublists
 */
+int _count_levels(struct _sl_node *head_node) {
+	int levels = 1;
 
-struct skip_list *skip_list_create(int (*gt_func)(void *, void *)) {
-	// initialize skip list structure
-	srand(time(NULL));
-	struct skip_list *new_skip_list = (struct skip_list *)malloc(sizeof(struct skip_list));
-	new_skip_list->_gt_func = gt_func;
-	new_skip_list->_size = 0;
-
-	// initialize first node [header doubly linked-list]
-	new_skip_list->_first_node = (struct _sl_node *)malloc(sizeof(struct _sl_node));
-	new_skip_list->_first_node->_prev_node = NULL;
-	new_skip_list->_first_node->_next_node = NULL;
-	new_skip_list->_first_node->_prev_layer = NULL;
-	new_skip_list->_first_node->_next_layer = NULL;
-	new_skip_list->_first_node->_data = NULL;
+	while(head_node->_next_layer) {
+		head_node = head_node->_next_layer;
+		++levels;
+	}
 
-	return new_skip_list;
+	return levels;
 }
 
-// Destructor
-
 /*
-* public function that dealocates memory used in a skip_list
-* 
+* This private function repeats the search done by _find_previous() while 
+* counting the work it does. It is kept apart from _find_previous() so the 
+* regular search path does not pay for the counting.
+*
 * Arguments:
-* 	struct skip_list *del_skip_list - pointer skip_list to be deleted
-* Return:
-	int - returns 0 if function was executed succesfully
+*	int (*gt_func)(void*, void*) - pointer to the gt_func of the list
+*	struct _sl_node *current_node - head node of the top sublist
+*	void *data - pointer to the data we are searching for
+*	int *visited - incremented for every node the search steps onto
+*	int *comparisons - incremented for every call to gt_func
 */
+void _probe_search(int (*gt_func)(void *, void *), 
+		struct _sl_node *current_node, 
+		void *data, 
+		int *visited, 
+		int *comparisons
+) {
+	while(current_node) {
+		while(current_node->_next_node) {
+			++(*comparisons);
+			if(!gt_func(data, current_node->_next_node->_data)) {
+				break;
+			}
+			current_node = current_node->_next_node;
+			++(*visited);
+		}
 
-int skip_list_destroy(struct skip_list *del_skip_list) {
-	_delete_skip_list(del_skip_list->_first_node);	// destroy skip list
-	free(del_skip_list);	// destroy container structure
-	return 0;
+		current_node = current_node->_next_layer;
+		if(current_node) {
+			++(*visited);
+		}
+	}
 }
 
-/*public functions - access functions*/
-
-/* 
-* public functiion that returns size of skip list
+/*
+* This private function returns the head node of the base list "l0".
 *
 * Arguments:
-*	struct skip_list *sl - pointer to skip list
-* Returns:
-*	int - returns the size of the skip list
+*	struct _sl_node *head_node - head node of the top sublist
 */
+struct _sl_node *_base_head(struct _sl_node *head_node) {
+	while(head_node->_next_layer) {
+		head_node = head_node->_next_layer;
+	}
 
-int skip_list_size(struct skip_list *sl) {
-	return sl->_size;
+	return head_node;
 }
 
-
-/* 
-* public functiion that searches a list for specified data
+/*
+* This private function adds an empty sublist on top of a skip list and 
+* returns the head node of the new sublist, or NULL if it could not be 
+* allocated.
 *
 * Arguments:
 *	struct skip_list *sl - pointer to skip list
-*	void *data - pointer to specified data the function needs to search for
-* Returns:
-*	int - returns 0 if data is not in the list 1 if it is.
 */
+struct _sl_node *_grow_height(struct skip_list *sl) {
+	struct _sl_node *new_layer;
 
-int skip_list_contains(struct skip_list *sl, void *data) {
-	struct _sl_node *prev_node;
-
-	// Find node before where "data" should be
-	prev_node = _find_previous(sl->_gt_func, sl->_first_node, data);
-
-	// Next node is NULL
-	if(!(prev_node->_next_node)) {
-		return 0;
+	new_layer = (struct _sl_node *)_sl_alloc(sl, sizeof(struct _sl_node));
+	if(!new_layer) {
+		return NULL;
 	}
+	new_layer->_prev_node = NULL;
+	new_layer->_next_node = NULL;
+	new_layer->_prev_layer = NULL;
+	new_layer->_next_layer = sl->_first_node;
+	new_layer->_data = NULL;
+	new_layer->_count = 0;
+	new_layer->_key._agg = sl->_monoid.identity;	// an empty sublist
 
-	// Next node contains "data"
-	return (prev_node->_next_node->_data) == data;
-}
+	sl->_first_node->_prev_layer = new_layer;
+	sl->_first_node = new_layer;
 
-/*public functions - modification functions*/
+	return new_layer;
+}
 
-/* 
-* public functiion that removes specified data from the skip list.
+/*
+* This private function finds both ends of l0 again after an operation that 
+* rebuilt the list's sublists in bulk.
 *
 * Arguments:
 *	struct skip_list *sl - pointer to skip list
-	void *data - pointer to specifed data the function needs to search for
-* Returns:
-*	int - returns 0 if data did not exist or not removed, 1 if data was 
-*		removed
 */
+void _refresh_ends(struct skip_list *sl) {
+	struct _sl_node *current_node = sl->_first_node;
 
-int skip_list_remove(struct skip_list *sl, void *data) {
-	struct _sl_node *prev_node;
+	// the last node of l0 ends the rightmost path
+	for(;;) {
+		while(current_node->_next_node) {
+			current_node = current_node->_next_node;
+		}
+		if(!(current_node->_next_layer)) {
+			break;
+		}
+		current_node = current_node->_next_layer;
+	}
 
-	// Find node before where "data" should be
-	prev_node = _find_previous(sl->_gt_func, sl->_first_node, data);
+	sl->_base_node = _base_head(sl->_first_node);
+	sl->_last_node = current_node == sl->_base_node ? NULL : current_node;
+}
 
-	// Next node is NULL or next node is not "data"
-	if(!(prev_node->_next_node) || (prev_node->_next_node->_data) != data) {
-		return 0;
-	}
+/*
+* This private function merges the nodes following src_head into the sublist
+* following dst_head, keeping the sublist ordered. Nodes from the dst list are 
+* placed first among equal elements so that every level makes the same choice
+* and the towers stay straight. src_head is left with an empty sublist.
+*
+* Arguments:
+*	int (*gt_func)(void*, void*) - pointer to the gt_func of the lists
+*	struct _sl_node *dst_head - head node of the sublist receiving the nodes
+*	struct _sl_node *src_head - head node of the sublist giving up its nodes
+*/
+void _merge_layer(int (*gt_func)(void *, void *), 
+		struct _sl_node *dst_head, 
+		struct _sl_node *src_head
+) {
+	struct _sl_node *tail_node = dst_head;
+	struct _sl_node *dst_node = dst_head->_next_node;
+	struct _sl_node *src_node = src_head->_next_node;
+	struct _sl_node *next_node;
 
-	// Remove node entirely from skip list
-	_delete_node(prev_node->_next_node);
+	while(dst_node && src_node) {
+		if(_SL_GT(gt_func, dst_node->_data, src_node->_data)) {
+			next_node = src_node;
+			src_node = src_node->_next_node;
+		} else {
+			next_node = dst_node;
+			dst_node = dst_node->_next_node;
+		}
+		tail_node->_next_node = next_node;
+		next_node->_prev_node = tail_node;
+		tail_node = next_node;
+	}
 
-	// Reduce skip list height
-	sl->_first_node = _reduce_height(sl->_first_node);
-	--(sl->_size);
+	// append whatever is left of either sublist
+	next_node = dst_node ? dst_node : src_node;
+	tail_node->_next_node = next_node;
+	if(next_node) {
+		next_node->_prev_node = tail_node;
+	}
 
-	return 1;
+	src_head->_next_node = NULL;
 }
 
-/* 
-* public functiion that inserts specified data from the skip list.
+/*
+* This private function frees every header above l0 of a skip list whose 
+* sublists have all been emptied, leaving the list with its l0 header only.
 *
 * Arguments:
 *	struct skip_list *sl - pointer to skip list
-*	void *data - pointer to specifed data the function needs to be added to
-*		the list.
-* Returns:
-*	int - returns 0 if data already existed in the list, 1 if data was 
-*		succesfully added.
 */
+void _truncate_to_base(struct skip_list *sl) {
+	struct _sl_node *base_head = _base_head(sl->_first_node);
 
-int skip_list_insert(struct skip_list *sl, void *data) {
-	struct _sl_node *prev_node;
-
-	// Find node before where data should be
-	prev_node = _find_previous(sl->_gt_func, sl->_first_node, data);
-
-	// Next node is not NULL and data is already inside of skip list
-	if(prev_node->_next_node && (prev_node->_next_node->_data) == data) {
-		return 0;
+	if(!(base_head->_prev_layer)) {
+		return;
 	}
-    
-	_insert_node(prev_node, NULL, data);
-	++(sl->_size);
 
-	return 1;
+	base_head->_prev_layer->_next_layer = NULL;
+	base_head->_prev_layer = NULL;
+	_delete_skip_list(sl, sl->_first_node);
+	sl->_first_node = base_head;
 }
 
-/* 
-* public functiion that prints out the list in rows and columns to improve 
-* readability when testing. The colums let you see the sublists more clearly. 
+/* _sl_builder
+* Appends elements to the end of a skip list in O(1) expected time each by 
+* remembering the last node of every level. The elements must arrive in order;
+* this is how lists are built from already sorted results.
+*/
+
+struct _sl_builder {
+	struct skip_list *_sl;
+	struct _sl_node **_tails;	// last node of every level, l0 first
+	int _levels;
+	int _failed;	// set once an element could not be allocated
+};
+
+/*
+* This private function prepares a builder that appends to the end of sl.
 *
 * Arguments:
-*	struct skip_list *sl - pointer to skip list
+*	struct _sl_builder *builder - builder to prepare
+*	struct skip_list *sl - pointer to skip list the elements are appended to
 */
+void _builder_init(struct _sl_builder *builder, struct skip_list *sl) {
+	struct _sl_node *current_node;
+	int level;
 
-void skip_list_print(struct skip_list *sl) {
-	//calculate pointer to L0 list
-	struct _sl_node *l0_list = sl->_first_node;
-	struct _sl_node *current_layer = sl->_first_node;
-	struct _sl_node *current_node = sl->_first_node;
-	struct _sl_node *l0_list_node = NULL;	
-
-	while(l0_list->_next_layer){
-		l0_list=l0_list->_next_layer;
+	builder->_sl = sl;
+	builder->_levels = _count_levels(sl->_first_node);
+	builder->_tails = (struct _sl_node **)malloc(builder->_levels * sizeof(struct _sl_node *));
+	builder->_failed = !(builder->_tails);
+	if(builder->_failed) {
+		return;
 	}
 
-	l0_list_node=l0_list;
-	if(current_node->_next_node){// if current list is not empty	
-		while(current_node || current_layer->_next_layer){
-			if(current_node){
-				while(sl->_gt_func(current_node->_data, l0_list_node->_next_node->_data) && l0_list_node->_next_node){
-					printf("-\t-");
-					l0_list_node=l0_list_node->_next_node;				
-				}
-				printf("->%ld", (long)current_node->_data);
-				current_node=current_node->_next_node;
-			}
-			if(!(current_node)&&(current_layer->_next_layer)){
-				current_layer=current_layer->_next_layer;
-				current_node=current_layer;
-				l0_list_node=l0_list;
-				printf("\n");		
-			}
+	// the last node of every level lies on the rightmost path
+	current_node = sl->_first_node;
+	for(level = builder->_levels - 1; level >= 0; --level) {
+		while(current_node->_next_node) {
+			current_node = current_node->_next_node;
 		}
-		printf("\n");			
-		return;	
+		builder->_tails[level] = current_node;
+		current_node = current_node->_next_layer;
 	}
 }
-int fifo_gt(void *a, void *b) {return (long)a > (long)b;}
-
-int main() {
-	struct skip_list *test_list;
-	test_list = skip_list_create(fifo_gt);
 
-	for(long i = 0; i < 30; i += 2)
-	{
-		skip_list_insert(test_list, (void *)i);
-	}
+/*
+* This private function appends data at the end of the builder's list and 
+* uses _coin_flip() on the list's seed to decide the height of its tower, 
+* adding sublists on top
+* when the tower outgrows the list. Byte string keys are tagged and filters
+* count the element in as _insert_after() does; aggregates are left to 
+* _rebuild_aggregates() once the list is built. Its arguments follow the 
+* visit callbacks so that it can collect the results of the set operations 
+* directly. Running out of memory above l0 only cuts the tower short; at l0 
+* it marks the builder failed and every later element is dropped.
+*
+* Arguments:
+*	void *data - pointer to data not less than the last element of the list
+*	void *builder - pointer to the struct _sl_builder
+*/
+void _builder_append(void *data, void *builder) {
+	struct _sl_builder *b = (struct _sl_builder *)builder;
+	struct _sl_node *new_node;
+	struct _sl_node *base_node = NULL;
+	struct _sl_node *below_node = NULL;
+	struct _sl_node **tails;
+	int level = 0;
 
-	for(long j = 0; j < 30; ++j)
-	{
-		printf("Contains %ld: %d\n", j, skip_list_contains(test_list, (void *)j));
+	if(b->_failed) {
+		return;
+	}
+
+	do {
+		if(level == b->_levels) {
+			tails = (struct _sl_node **)realloc(b->_tails, (b->_levels + 1) * sizeof(struct _sl_node *));
+			if(!tails) {
+				break;
+			}
+			b->_tails = tails;
+			if(!(b->_tails[b->_levels] = _grow_height(b->_sl))) {
+				break;
+			}
+			++(b->_levels);
+		}
+
+		new_node = _node_alloc(b->_sl, below_node, data);
+		if(!new_node) {
+			break;
+		}
+		new_node->_prev_node = b->_tails[level];
+		new_node->_next_node = NULL;
+
+		b->_tails[level]->_next_node = new_node;
+		if(below_node) {
+			below_node->_prev_layer = new_node;
+		} else {
+			base_node = new_node;
+		}
+
+		b->_tails[level++] = new_node;
+		below_node = new_node;
+	} while(_coin_flip(&(b->_sl->_seed)));
+
+	if(!base_node) {
+		b->_failed = 1;
+		return;
+	}
+	++(b->_sl->_size);
+	if(b->_sl->_bytes) {
+		_bytes_tag(base_node);
+	}
+	if(b->_sl->_filter) {
+		_filter_add(b->_sl, data);
+	}
+}
+
+/*
+* This private function releases the memory held by a builder once the list it
+* built is complete.
+*/
+void _builder_finish(struct _sl_builder *builder) {
+	_refresh_ends(builder->_sl);
+	free(builder->_tails);
+}
+
+/* _sl_finger
+* Remembers the search path of the last lookup, one node per level with l0 
+* first. A lookup for a key not less than the previous one climbs only as 
+* high as it needs to from the old path, so a sequence of increasing lookups 
+* that are d elements apart costs O(log d) each instead of O(log n).
+*/
+
+struct _sl_finger {
+	int (*_gt_func)(void *, void *);
+	struct _sl_node **_path;
+	int _levels;
+};
+
+/*
+* This private function places a finger on the headers of a skip list. It 
+* returns 0, or -1 if the path could not be allocated.
+*/
+int _finger_init(struct _sl_finger *finger, struct skip_list *sl) {
+	struct _sl_node *head_node = sl->_first_node;
+	int level;
+
+	finger->_gt_func = sl->_gt_func;
+	finger->_levels = _count_levels(head_node);
+	finger->_path = (struct _sl_node **)malloc(finger->_levels * sizeof(struct _sl_node *));
+	if(!(finger->_path)) {
+		return -1;
+	}
+	for(level = finger->_levels - 1; level >= 0; --level) {
+		finger->_path[level] = head_node;
+		head_node = head_node->_next_layer;
+	}
+
+	return 0;
+}
+
+/*
+* This private function moves a finger forward to data and returns the l0 node
+* before the first node that is greater or equal to data, like _find_previous().
+* data must not be less than the data of the previous search.
+*
+* Arguments:
+*	struct _sl_finger *finger - finger left by the previous search
+*	void *data - pointer to the data we are searching for
+* Returns:
+*	struct _sl_node * - l0 node before the first node gt or equal to data
+*/
+struct _sl_node *_finger_search(struct _sl_finger *finger, void *data) {
+	struct _sl_node **path = finger->_path;
+	struct _sl_node *current_node;
+	int level = 0;
+
+	// climb while the next node on the level above is still before data
+	while(level + 1 < finger->_levels && path[level + 1]->_next_node && 
+			_SL_GT(finger->_gt_func, data, path[level + 1]->_next_node->_data)) {
+		++level;
+	}
+
+	current_node = path[level];
+	for(;;) {
+		while(current_node->_next_node && _SL_GT(finger->_gt_func, data, current_node->_next_node->_data)) {
+			current_node = current_node->_next_node;
+		}
+
+		if(!level) {
+			path[level] = current_node;
+			return current_node;
+		}
+
+		// lower levels of the path are never older than higher ones, so if 
+		// this level did not get past the old path the level below is ahead
+		if(current_node == path[level]) {
+			current_node = path[level - 1];
+		} else {
+			path[level] = current_node;
+			current_node = current_node->_next_layer;
+		}
+		--level;
+	}
+}
+
+/*
+* This private function releases the memory held by a finger.
+*/
+void _finger_finish(struct _sl_finger *finger) {
+	free(finger->_path);
+}
+
+/*
+* This private function recomputes the aggregate of one node from the level 
+* below: from the element itself on l0, or from the nodes below it up to the 
+* one below its _next_node on higher levels.
+*
+* Arguments:
+*	struct skip_list *sl - pointer to skip list
+*	struct _sl_node *node - node whose aggregate is recomputed
+*/
+void _recompute_aggregate(struct skip_list *sl, struct _sl_node *node) {
+	struct _sl_node *current_node;
+	struct _sl_node *stop_node;
+	double aggregate = sl->_monoid.identity;
+	int copy;
+
+	if(!(node->_next_layer)) {
+		for(copy = 0; node->_prev_node && copy < node->_count; ++copy) {
+			aggregate = sl->_monoid.combine(aggregate, sl->_monoid.value(node->_data));
+		}
+		node->_key._agg = aggregate;
+		return;
+	}
+
+	stop_node = node->_next_node ? node->_next_node->_next_layer : NULL;
+	for(current_node = node->_next_layer; current_node != stop_node; current_node = current_node->_next_node) {
+		aggregate = sl->_monoid.combine(aggregate, current_node->_key._agg);
+	}
+	node->_key._agg = aggregate;
+}
+
+/*
+* This private function repairs the aggregates after the l0 node has changed,
+* been inserted, or had its successor removed. On every level it recomputes 
+* the node whose link passes over the l0 node, found by walking back to the 
+* nearest taller tower like _insert_node() does, so this is O(log n).
+*
+* Arguments:
+*	struct skip_list *sl - pointer to skip list
+*	struct _sl_node *node - l0 node at which the list changed
+*/
+void _update_aggregates(struct skip_list *sl, struct _sl_node *node) {
+	if(!(sl->_aggregate)) {
+		return;
+	}
+
+	_recompute_aggregate(sl, node);
+	for(;;) {
+		if(node->_prev_layer) {
+			// the tower's own link and the one leading to it both changed
+			node = node->_prev_layer;
+			if(node->_prev_node) {
+				_recompute_aggregate(sl, node->_prev_node);
+			}
+		} else {
+			while(!(node->_prev_layer) && node->_prev_node) {
+				node = node->_prev_node;
+			}
+			if(!(node->_prev_layer)) {
+				return;
+			}
+			node = node->_prev_layer;
+		}
+		_recompute_aggregate(sl, node);
+	}
+}
+
+/*
+* This private function recomputes every aggregate of a list, level by level
+* from l0 upward, after an operation that rebuilt the list in bulk.
+*
+* Arguments:
+*	struct skip_list *sl - pointer to skip list
+*/
+void _rebuild_aggregates(struct skip_list *sl) {
+	struct _sl_node *head_node;
+	struct _sl_node *current_node;
+
+	if(!(sl->_aggregate)) {
+		return;
+	}
+
+	for(head_node = sl->_base_node; head_node; head_node = head_node->_prev_layer) {
+		for(current_node = head_node; current_node; current_node = current_node->_next_node) {
+			_recompute_aggregate(sl, current_node);
+		}
+	}
+}
+
+/*
+* This private function inserts a new tower for data after an l0 node and 
+* keeps the size and both ends of the list up to date.
+*
+* Arguments:
+*	struct skip_list *sl - pointer to skip list
+*	struct _sl_node *prev_node - l0 node the new node follows
+*	void *data - pointer to data for the new node
+* Return:
+*	struct _sl_node * - the new l0 node, NULL if it could not be allocated
+*/
+struct _sl_node *_insert_after(struct skip_list *sl, struct _sl_node *prev_node, void *data) {
+	struct _sl_node *new_node;
+
+	new_node = _insert_node(sl, prev_node, NULL, data);
+	if(!new_node) {
+		return NULL;
+	}
+	++(sl->_size);
+
+	// a list growing out of a single sublist pushes its l0 header up
+	while(sl->_base_node->_next_layer) {
+		sl->_base_node = sl->_base_node->_next_layer;
+	}
+	if(!(new_node->_next_node)) {
+		sl->_last_node = new_node;
+	}
+
+	if(sl->_bytes) {
+		_bytes_tag(new_node);
+	}
+	if(sl->_filter) {
+		_filter_add(sl, data);
+	}
+	_update_aggregates(sl, new_node);
+	return new_node;
+}
+
+/*
+* This private function checks whether an l0 node holds data: the same pointer
+* normally, or an equal key in multiset mode.
+*
+* Arguments:
+*	struct skip_list *sl - pointer to skip list
+*	struct _sl_node *node - l0 node to check, may be NULL
+*	void *data - pointer to the data we are searching for
+* Return:
+*	int - returns 1 if the node holds data, 0 otherwise
+*/
+int _matches(struct skip_list *sl, struct _sl_node *node, void *data) {
+	if(!node) {
+		return 0;
+	}
+
+	if(sl->_multiset) {
+		return !_SL_GT(sl->_gt_func, node->_data, data);
+	}
+
+	return node->_data == data;
+}
+
+/*
+* This private function looks a key up in a list's cache. The fields of an
+* entry are read and written one by one with relaxed atomics, so lookups 
+* that share a read lock can fill it at the same time: a mix of two entries 
+* still names a node that is in the list, and _matches() checks it.
+*
+* Returns:
+*	struct _sl_node * - the l0 node holding data, NULL on a miss
+*/
+struct _sl_node *_cache_find(struct skip_list *sl, void *data, unsigned long long hash) {
+	struct _sl_cache *cache = sl->_cache;
+	struct _sl_cache_entry *entry = &(cache->_entries[hash & cache->_mask]);
+	struct _sl_node *node;
+
+	if(__atomic_load_n(&(entry->_hash), __ATOMIC_RELAXED) != hash || 
+			__atomic_load_n(&(entry->_generation), __ATOMIC_RELAXED) != cache->_generation) {
+		return NULL;
+	}
+	node = __atomic_load_n(&(entry->_node), __ATOMIC_RELAXED);
+
+	return _matches(sl, node, data) ? node : NULL;
+}
+
+void _cache_fill(struct skip_list *sl, struct _sl_node *node, unsigned long long hash) {
+	struct _sl_cache *cache = sl->_cache;
+	struct _sl_cache_entry *entry = &(cache->_entries[hash & cache->_mask]);
+
+	__atomic_store_n(&(entry->_hash), hash, __ATOMIC_RELAXED);
+	__atomic_store_n(&(entry->_generation), cache->_generation, __ATOMIC_RELAXED);
+	__atomic_store_n(&(entry->_node), node, __ATOMIC_RELAXED);
+}
+
+/*
+* This private function clears the cache entry of an l0 node that is about
+* to be freed.
+*/
+void _cache_forget(struct skip_list *sl, struct _sl_node *node) {
+	struct _sl_cache *cache = sl->_cache;
+	struct _sl_cache_entry *entry = &(cache->_entries[_hash_element(cache->_hash, node->_data) & cache->_mask]);
+
+	if(entry->_node == node) {
+		entry->_node = NULL;
+	}
+}
+
+/*
+* This private function empties a list's cache, if it has one, after nodes 
+* were moved out of the list or freed wholesale.
+*/
+void _cache_invalidate(struct skip_list *sl) {
+	if(sl->_cache) {
+		++(sl->_cache->_generation);
+	}
+}
+
+/*
+* This private function removes the tower above an l0 node, with every copy 
+* the node counts, and lowers the list if a sublist became empty.
+*
+* Arguments:
+*	struct skip_list *sl - pointer to skip list
+*	struct _sl_node *node - l0 node to remove
+*/
+void _remove_tower(struct skip_list *sl, struct _sl_node *node) {
+	struct _sl_node *prev_node = node->_prev_node;
+
+	if(node == sl->_last_node) {
+		sl->_last_node = prev_node->_prev_node ? prev_node : NULL;
+	}
+	sl->_size -= node->_count;
+	if(sl->_filter) {
+		_filter_remove(sl, node->_data);
+	}
+	if(sl->_cache) {
+		_cache_forget(sl, node);
+	}
+	_delete_node(sl, node);
+	sl->_first_node = _reduce_height(sl, sl->_first_node);
+	_update_aggregates(sl, prev_node);
+}
+
+/*
+* This private function removes one copy of the element held by an l0 node, 
+* and the node itself once no copy is left.
+*
+* Arguments:
+*	struct skip_list *sl - pointer to skip list
+*	struct _sl_node *node - l0 node to remove a copy from
+*/
+void _remove_copy(struct skip_list *sl, struct _sl_node *node) {
+	if(node->_count == 1) {
+		_remove_tower(sl, node);
+		return;
+	}
+
+	--(node->_count);
+	--(sl->_size);
+	_update_aggregates(sl, node);
+}
+
+/*
+* This private function frees a run of l0 nodes that has already been cut out
+* of every sublist, together with the towers standing on them.
+*
+* Arguments:
+*	struct skip_list *sl - pointer to skip list the run was cut from
+*	struct _sl_node *first_node - first l0 node of the run
+*	struct _sl_node *last_node - last l0 node of the run
+*	void (*visit)(void *, void *) - called with the data of every node 
+*		before it is freed, may be NULL
+*	void *ctx - pointer passed through to visit
+* Return:
+*	int - number of elements the run held
+*/
+int _free_segment(struct skip_list *sl,
+		struct _sl_node *first_node, 
+		struct _sl_node *last_node, 
+		void (*visit)(void *, void *), 
+		void *ctx
+) {
+	struct _sl_node *next_node;
+	struct _sl_node *tower_node;
+	int count = 0;
+
+	_cache_invalidate(sl);
+	last_node->_next_node = NULL;
+	while(first_node) {
+		next_node = first_node->_next_node;
+		count += first_node->_count;
+		if(sl->_filter) {
+			_filter_remove(sl, first_node->_data);
+		}
+		if(visit) {
+			visit(first_node->_data, ctx);
+		}
+
+		while(first_node) {
+			tower_node = first_node->_prev_layer;
+			_sl_free(sl, first_node, _node_bytes(sl, first_node));
+			first_node = tower_node;
+		}
+		first_node = next_node;
+	}
+
+	return count;
+}
+
+/*
+* This private function frees the marker lists of an interval skip list, and 
+* every interval with them.
+*
+* Arguments:
+*	struct skip_list *sl - pointer to skip list
+*/
+void _free_markers(struct skip_list *sl) {
+	struct _sl_node *head_node;
+	struct _sl_node *current_node;
+	struct _sl_marker *marker;
+
+	for(head_node = sl->_first_node; head_node; head_node = head_node->_next_layer) {
+		for(current_node = head_node; current_node; current_node = current_node->_next_node) {
+			while(current_node->_key._markers) {
+				marker = current_node->_key._markers;
+				current_node->_key._markers = marker->_next;
+
+				// every interval has exactly one hi marker
+				if(marker->_kind == _SL_MARK_HI) {
+					_sl_free(sl, marker->_interval, sizeof(struct skip_list_interval));
+				}
+				_sl_free(sl, marker, sizeof(struct _sl_marker));
+			}
+		}
+	}
+}
+
+/*
+* This private function frees every version and snapshot of a multi-version
+* skip list.
+*/
+void _free_versions(struct skip_list *sl) {
+	struct _sl_node *current_node;
+	struct _sl_version *version;
+	struct skip_list_snapshot *snapshot;
+
+	for(current_node = sl->_base_node->_next_node; current_node; current_node = current_node->_next_node) {
+		while((version = current_node->_key._versions)) {
+			current_node->_key._versions = version->_older;
+			_sl_free(sl, version, sizeof(struct _sl_version));
+		}
+	}
+	while((snapshot = sl->_snapshots)) {
+		sl->_snapshots = snapshot->_next;
+		_sl_free(sl, snapshot, sizeof(struct skip_list_snapshot));
+	}
+}
+
+/*public functions - construction and destruction functions*/
+
+//constructor
+
+/*
+* public function that initializes a new skip list
+* 
+* Arguments:
+* 	int (*gt_func)(void *, void *) - pointer to the greater than function
+*		to be used when initilizing a skip list
+* Return:
+	struct skip_list * - pointer to a new skip list, NULL if it could not be 
+*		allocated
+*/
+
+struct skip_list *skip_list_create(int (*gt_func)(void *, void *)) {
+	// initialize skip list structure
+	struct skip_list *new_skip_list = (struct skip_list *)malloc(sizeof(struct skip_list));
+	if(!new_skip_list) {
+		return NULL;
+	}
+	_SL_COUNT(allocations);
+	new_skip_list->_gt_func = gt_func;
+	new_skip_list->_size = 0;
+	new_skip_list->_size_stale = 0;
+	new_skip_list->_multiset = 0;
+	new_skip_list->_allocator.alloc = _default_alloc;
+	new_skip_list->_allocator.free = _default_free;
+	new_skip_list->_allocator.ctx = NULL;
+
+	// initialize first node [header doubly linked-list]
+	new_skip_list->_first_node = (struct _sl_node *)_sl_alloc(new_skip_list, sizeof(struct _sl_node));
+	if(!(new_skip_list->_first_node)) {
+		free(new_skip_list);
+		return NULL;
+	}
+	new_skip_list->_first_node->_prev_node = NULL;
+	new_skip_list->_first_node->_next_node = NULL;
+	new_skip_list->_first_node->_prev_layer = NULL;
+	new_skip_list->_first_node->_next_layer = NULL;
+	new_skip_list->_first_node->_data = NULL;
+	new_skip_list->_first_node->_count = 0;
+	new_skip_list->_base_node = new_skip_list->_first_node;
+	new_skip_list->_last_node = NULL;
+	new_skip_list->_aggregate = 0;
+	new_skip_list->_monoid.identity = 0;
+	new_skip_list->_monoid.combine = NULL;
+	new_skip_list->_monoid.value = NULL;
+	new_skip_list->_interval = 0;
+	new_skip_list->_bytes = 0;
+	new_skip_list->_mvcc = 0;
+	new_skip_list->_sequence = 0;
+	new_skip_list->_snapshots = NULL;
+	new_skip_list->_newest_snapshot = NULL;
+	new_skip_list->_filter = NULL;
+	new_skip_list->_cache = NULL;
+	new_skip_list->_node_size = _SL_NODE_LINKS;
+	new_skip_list->_seed = _seed_new();
+
+	return new_skip_list;
+}
+
+/*
+* public function that initializes a new skip list in multiset mode. A 
+* multiset matches elements by key instead of by pointer: inserting an element
+* equal to one already in the list adds to that node's count instead of 
+* building a new tower, and the first element inserted represents the key.
+* 
+* Arguments:
+* 	int (*gt_func)(void *, void *) - pointer to the greater than function
+*		to be used when initilizing a skip list
+* Return:
+	struct skip_list * - pointer to a new skip list, NULL if it could not be 
+*		allocated
+*/
+
+struct skip_list *skip_list_create_multiset(int (*gt_func)(void *, void *)) {
+	struct skip_list *new_skip_list = skip_list_create(gt_func);
+
+	if(new_skip_list) {
+		new_skip_list->_multiset = 1;
+	}
+
+	return new_skip_list;
+}
+
+/*
+* public function that initializes a new skip list ordered by deadline. The 
+* deadline is stored in the nodes and compared directly, so the list has no 
+* gt_func: fill it with skip_list_insert_with_deadline() and drain it with 
+* skip_list_expire_until(). The functions that do not compare elements, such
+* as skip_list_size() and skip_list_pop_min(), work as usual; the ones that 
+* take an element to compare must not be used. The ones that compare the 
+* elements of two lists, or a range, refuse it: skip_list_merge(), 
+* skip_list_concat(), skip_list_split(), skip_list_remove_range() and the set
+* operations.
+* 
+* Return:
+	struct skip_list * - pointer to a new skip list, NULL if it could not be 
+*		allocated
+*/
+
+struct skip_list *skip_list_create_ttl(void) {
+	struct skip_list *new_skip_list = skip_list_create(NULL);
+
+	if(new_skip_list) {
+		new_skip_list->_node_size = sizeof(struct _sl_node);	// deadlines on every level
+	}
+
+	return new_skip_list;
+}
+
+/*
+* public function that initializes a new skip list of byte string keys. Its 
+* elements point to a struct skip_list_bytes, or to a struct starting with one,
+* and are ordered like memcmp(). Searches compare the inline prefix kept in 
+* every node first and only read the key bytes of a node when the prefixes 
+* are equal and both keys are longer than SKIP_LIST_BYTES_INLINE.
+* 
+* Return:
+	struct skip_list * - pointer to a new skip list, NULL if it could not be 
+*		allocated
+*/
+
+struct skip_list *skip_list_create_bytes(void) {
+	struct skip_list *new_skip_list = skip_list_create(_bytes_gt);
+
+	if(new_skip_list) {
+		new_skip_list->_bytes = 1;
+		new_skip_list->_node_size = sizeof(struct _sl_node);	// prefixes on every level
+	}
+
+	return new_skip_list;
+}
+
+/*
+* public function that initializes a new interval skip list. The keys of the 
+* list are the endpoints of the intervals it stores, each counted once for 
+* every interval that starts or ends there, so skip_list_size() reports two 
+* per interval. Fill it with skip_list_interval_insert() and query it with 
+* skip_list_stab() and skip_list_overlap(); the functions that add or remove
+* elements directly must not be used.
+* 
+* Arguments:
+* 	int (*gt_func)(void *, void *) - pointer to the greater than function
+*		used to compare endpoints
+* Return:
+	struct skip_list * - pointer to a new skip list, NULL if it could not be 
+*		allocated
+*/
+
+struct skip_list *skip_list_create_interval(int (*gt_func)(void *, void *)) {
+	struct skip_list *new_skip_list = skip_list_create_multiset(gt_func);
+
+	if(new_skip_list) {
+		new_skip_list->_interval = 1;
+		new_skip_list->_first_node->_key._markers = NULL;
+		new_skip_list->_node_size = sizeof(struct _sl_node);	// markers on every level
+	}
+
+	return new_skip_list;
+}
+
+/*
+* public function that initializes a new multi-version skip list, in which 
+* every key keeps the values it was given, each tagged with the sequence 
+* number of its write. Reads at a snapshot see the list as it was when the 
+* snapshot was taken, and versions are freed once no snapshot can see them. 
+* skip_list_size() counts the keys that still hold a version. Write it with 
+* skip_list_mvcc_put() and skip_list_mvcc_delete() and read it with 
+* skip_list_mvcc_get() and skip_list_mvcc_next(); the functions that add or 
+* remove elements directly must not be used.
+* 
+* Arguments:
+* 	int (*gt_func)(void *, void *) - pointer to the greater than function
+*		used to compare keys
+* Return:
+	struct skip_list * - pointer to a new skip list, NULL if it could not be 
+*		allocated
+*/
+
+struct skip_list *skip_list_create_mvcc(int (*gt_func)(void *, void *)) {
+	struct skip_list *new_skip_list = skip_list_create_multiset(gt_func);
+
+	if(new_skip_list) {
+		new_skip_list->_mvcc = 1;
+	}
+
+	return new_skip_list;
+}
+
+/*
+* public function that makes an empty skip list take its nodes from allocator
+* instead of malloc(). Call it right after creating the list, with any of the
+* skip_list_create functions; the allocator must outlive the list. Lists that
+* exchange nodes, through skip_list_merge() or skip_list_concat(), must use 
+* the same allocator. The list structure itself still comes from malloc().
+* 
+* Arguments:
+*	struct skip_list *sl - pointer to an empty skip list
+*	struct skip_list_allocator *allocator - allocator to use, copied into 
+*		the list
+* Return:
+*	int - returns 0 if the list is not empty or the allocator could not 
+*		allocate the header, 1 if the allocator was set
+*/
+
+int skip_list_set_allocator(struct skip_list *sl, struct skip_list_allocator *allocator) {
+	struct _sl_node *head_node = sl->_first_node;
+	struct skip_list_allocator old_allocator = sl->_allocator;
+
+	if(head_node->_next_node || head_node->_next_layer) {
+		return 0;
+	}
+
+	// the header came from the old allocator, move it to the new one
+	sl->_allocator = *allocator;
+	sl->_first_node = (struct _sl_node *)_sl_alloc(sl, sizeof(struct _sl_node));
+	if(!(sl->_first_node)) {
+		sl->_allocator = old_allocator;
+		sl->_first_node = head_node;
+		return 0;
+	}
+	*(sl->_first_node) = *head_node;
+	sl->_base_node = sl->_first_node;
+	old_allocator.free(head_node, sizeof(struct _sl_node), old_allocator.ctx);
+	_SL_COUNT(frees);
+
+	return 1;
+}
+
+/*
+* public function that puts a membership filter in front of the lookups of
+* skip_list_contains(), so that most lookups for elements that are not in the
+* list skip the search and touch one cache line instead. The filter counts 
+* elements in and out as they are inserted and removed, grows with the list,
+* and reports its traffic through skip_list_stats(). hash must give equal 
+* elements equal hashes: by key in multiset mode, and by pointer otherwise,
+* which is what a NULL hash does. Calling it again resizes the filter and 
+* resets its statistics.
+* 
+* Arguments:
+*	struct skip_list *sl - pointer to skip list
+*	unsigned long long (*hash)(void *) - hash of an element, NULL to hash 
+*		the pointer
+*	int capacity - number of elements to size the filter for
+*	double fp_rate - share of misses the filter may let through, rounded 
+*		down to a power of two between 2^-16 and 1/2
+* Return:
+*	int - returns 1 if the filter was set, 0 if it could not be allocated
+*/
+
+int skip_list_set_filter(struct skip_list *sl, unsigned long long (*hash)(void *), int capacity, double fp_rate) {
+	struct _sl_filter *filter = sl->_filter;
+	struct _sl_filter old_filter;
+
+	if(!filter) {
+		filter = (struct _sl_filter *)calloc(1, sizeof(struct _sl_filter));
+		if(!filter) {
+			return 0;
+		}
+		sl->_filter = filter;
+	}
+	old_filter = *filter;
+
+	filter->_hash = hash;
+	for(filter->_bits = 1; filter->_bits < 16 && fp_rate * 2 < 1; ++(filter->_bits)) {
+		fp_rate *= 2;
+	}
+	filter->_probes = filter->_bits;
+
+	if(!_filter_build(sl, capacity > 0 ? capacity : 1)) {
+		// keep the old filter, whose counters were set with its own settings
+		*filter = old_filter;
+		if(!(filter->_blocks)) {
+			free(filter);
+			sl->_filter = NULL;
+		}
+		return 0;
+	}
+	filter->_queries = 0;
+	filter->_negatives = 0;
+	filter->_false_positives = 0;
+
+	return 1;
+}
+
+/*
+* public function that puts a direct-mapped cache of l0 nodes in front of 
+* the lookups of skip_list_contains(). An element that was found is kept in
+* the slot its hash picks, so looking it up again costs the hash, one slot
+* and one node instead of a search; for skewed lookups the hot keys stay in
+* the cache. hash must give equal elements equal hashes, as for 
+* skip_list_set_filter(). Calling it again replaces the cache, and 0 entries
+* removes it.
+* 
+* Arguments:
+*	struct skip_list *sl - pointer to skip list
+*	unsigned long long (*hash)(void *) - hash of an element, NULL to hash 
+*		the pointer
+*	int entries - number of slots, rounded up to a power of two
+* Return:
+*	int - returns 1 if the cache was set or removed, 0 if it could not be 
+*		allocated
+*/
+
+int skip_list_set_cache(struct skip_list *sl, unsigned long long (*hash)(void *), int entries) {
+	struct _sl_cache *cache;
+	unsigned long size = 1;
+
+	if(entries <= 0) {
+		if(sl->_cache) {
+			free(sl->_cache->_entries);
+			free(sl->_cache);
+			sl->_cache = NULL;
+		}
+		return 1;
+	}
+
+	while(size < (unsigned long)entries) {
+		size *= 2;
+	}
+	cache = (struct _sl_cache *)malloc(sizeof(struct _sl_cache));
+	if(!cache) {
+		return 0;
+	}
+	cache->_entries = (struct _sl_cache_entry *)calloc(size, sizeof(struct _sl_cache_entry));
+	if(!(cache->_entries)) {
+		free(cache);
+		return 0;
+	}
+	cache->_hash = hash;
+	cache->_mask = size - 1;
+	cache->_generation = 0;
+
+	skip_list_set_cache(sl, NULL, 0);
+	sl->_cache = cache;
+
+	return 1;
+}
+
+// Destructor
+
+/*
+* public function that dealocates memory used in a skip_list
+* 
+* Arguments:
+* 	struct skip_list *del_skip_list - pointer skip_list to be deleted
+* Return:
+	int - returns 0 if function was executed succesfully
+*/
+
+int skip_list_destroy(struct skip_list *del_skip_list) {
+	if(del_skip_list->_interval) {
+		_free_markers(del_skip_list);
+	}
+	if(del_skip_list->_mvcc) {
+		_free_versions(del_skip_list);
+	}
+	if(del_skip_list->_filter) {
+		free(del_skip_list->_filter->_blocks);
+		free(del_skip_list->_filter);
+	}
+	skip_list_set_cache(del_skip_list, NULL, 0);
+	_delete_skip_list(del_skip_list, del_skip_list->_first_node);	// destroy skip list
+	free(del_skip_list);	// destroy container structure
+	_SL_COUNT(frees);
+	return 0;
+}
+
+/*public functions - access functions*/
+
+/* 
+* public functiion that returns size of skip list. This is O(1) except for the
+* first call after a split or concatenation, which recounts l0.
+*
+* Arguments:
+*	struct skip_list *sl - pointer to skip list
+* Returns:
+*	int - returns the size of the skip list
+*/
+
+int skip_list_size(struct skip_list *sl) {
+	struct _sl_node *current_node;
+
+	if(sl->_size_stale) {
+		sl->_size = 0;
+		current_node = _base_head(sl->_first_node)->_next_node;
+		for(; current_node; current_node = current_node->_next_node) {
+			sl->_size += current_node->_count;
+		}
+		sl->_size_stale = 0;
+	}
+
+	return sl->_size;
+}
+
+
+/* 
+* public functiion that searches a list for specified data
+*
+* Arguments:
+*	struct skip_list *sl - pointer to skip list
+*	void *data - pointer to specified data the function needs to search for
+* Returns:
+*	int - returns 0 if data is not in the list 1 if it is.
+*/
+
+int skip_list_contains(struct skip_list *sl, void *data) {
+	struct _sl_node *prev_node;
+	unsigned long long hash = 0;
+	int found;
+	_SL_LATENCY_BEGIN(SKIP_LIST_OP_CONTAINS);
+
+	// hot keys are found in the cache without a search
+	if(sl->_cache) {
+		hash = _hash_element(sl->_cache->_hash, data);
+		if(_cache_find(sl, data, hash)) {
+			_SL_LATENCY_END(SKIP_LIST_OP_CONTAINS);
+			return 1;
+		}
+	}
+
+	// a miss in the filter is certain, skip the search
+	if(sl->_filter) {
+		__atomic_fetch_add(&(sl->_filter->_queries), 1, __ATOMIC_RELAXED);
+		if(!_filter_update(sl->_filter, data, 0)) {
+			__atomic_fetch_add(&(sl->_filter->_negatives), 1, __ATOMIC_RELAXED);
+			_SL_LATENCY_END(SKIP_LIST_OP_CONTAINS);
+			return 0;
+		}
+	}
+
+	// Find node before where "data" should be
+	prev_node = _search(sl, data);
+	_SL_LATENCY_END(SKIP_LIST_OP_CONTAINS);
+
+	// Next node contains "data"
+	found = _matches(sl, prev_node->_next_node, data);
+	if(sl->_filter && !found) {
+		__atomic_fetch_add(&(sl->_filter->_false_positives), 1, __ATOMIC_RELAXED);
+	}
+	if(sl->_cache && found) {
+		_cache_fill(sl, prev_node->_next_node, hash);
+	}
+	return found;
+}
+
+/* 
+* public function that counts the elements equal to key, comparing by key 
+* rather than by pointer. In multiset mode this is the count kept in the 
+* node; otherwise the run of equal elements is walked.
+*
+* Arguments:
+*	struct skip_list *sl - pointer to skip list
+*	void *key - pointer to data equal to the elements to count
+* Returns:
+*	int - returns the number of elements equal to key
+*/
+
+int skip_list_count(struct skip_list *sl, void *key) {
+	struct _sl_node *current_node;
+	int count = 0;
+
+	current_node = _search(sl, key)->_next_node;
+	for(; current_node && !_SL_GT(sl->_gt_func, current_node->_data, key); current_node = current_node->_next_node) {
+		count += current_node->_count;
+	}
+
+	return count;
+}
+
+/* 
+* public function that reports the shape of a skip list. It walks every level
+* once and samples up to SKIP_LIST_STATS_PROBES searches for elements spread
+* evenly across l0, so it costs O(n) and is meant for monitoring, not for the
+* hot path.
+*
+* Arguments:
+*	struct skip_list *sl - pointer to skip list
+*	struct skip_list_stats *stats - structure that receives the statistics
+* Returns:
+*	int - returns 0 if function was executed succesfully
+*/
+
+int skip_list_stats(struct skip_list *sl, struct skip_list_stats *stats) {
+	struct _sl_node *head_node;
+	struct _sl_node *current_node;
+	struct _sl_node *tower_node;
+	int level;
+	int height;
+	int index;
+	int samples;
+	int visited;
+	int comparisons;
+	long total_visited = 0;
+	long total_comparisons = 0;
+
+	stats->levels = _count_levels(sl->_first_node);
+	stats->size = 0;
+	stats->probes = 0;
+	stats->max_search_path = 0;
+	stats->avg_search_path = 0;
+	stats->avg_comparisons = 0;
+	stats->total_bytes = sizeof(struct skip_list);
+	stats->page_mode = SKIP_LIST_PAGES_DEFAULT;
+	stats->filter_queries = 0;
+	stats->filter_negatives = 0;
+	stats->filter_false_positives = 0;
+	if(sl->_filter) {
+		stats->total_bytes += sizeof(struct _sl_filter) + sl->_filter->_block_count * _SL_FILTER_BLOCK;
+		stats->filter_queries = sl->_filter->_queries;
+		stats->filter_negatives = sl->_filter->_negatives;
+		stats->filter_false_positives = sl->_filter->_false_positives;
+	}
+	for(level = 0; level < SKIP_LIST_STATS_LEVELS; ++level) {
+		stats->height_histogram[level] = 0;
+		stats->nodes_per_level[level] = 0;
+	}
+
+	// count the nodes of every level, starting from the top sublist
+	head_node = sl->_first_node;
+	for(level = stats->levels - 1; head_node; --level) {
+		stats->total_bytes += sizeof(struct _sl_node);	// header node
+		for(current_node = head_node->_next_node; current_node; current_node = current_node->_next_node) {
+			++(stats->nodes_per_level[level < SKIP_LIST_STATS_LEVELS ? level : SKIP_LIST_STATS_LEVELS - 1]);
+			stats->total_bytes += _node_bytes(sl, current_node);
+		}
+		head_node = head_node->_next_layer;
+	}
+
+	// measure the tower above every l0 node
+	head_node = sl->_first_node;
+	while(head_node->_next_layer) {
+		head_node = head_node->_next_layer;
+	}
+	for(current_node = head_node->_next_node; current_node; current_node = current_node->_next_node) {
+		height = 0;
+		for(tower_node = current_node; tower_node; tower_node = tower_node->_prev_layer) {
+			++height;
+		}
+		++(stats->height_histogram[height <= SKIP_LIST_STATS_LEVELS ? height - 1 : SKIP_LIST_STATS_LEVELS - 1]);
+		++(stats->size);
+	}
+
+	if(!stats->size || !sl->_gt_func) {
+		return 0;
+	}
+
+	// sample searches for elements spread evenly over l0, probe k at index 
+	// k * size / samples so the last one lands near the end of the list
+	samples = stats->size < SKIP_LIST_STATS_PROBES ? stats->size : SKIP_LIST_STATS_PROBES;
+	index = 0;
+	for(current_node = head_node->_next_node; current_node && stats->probes < samples; current_node = current_node->_next_node) {
+		if(index++ != (int)((long long)stats->probes * stats->size / samples)) {
+			continue;
+		}
+		visited = 0;
+		comparisons = 0;
+		_probe_search(sl->_gt_func, sl->_first_node, current_node->_data, &visited, &comparisons);
+		total_visited += visited;
+		total_comparisons += comparisons;
+		if(visited > stats->max_search_path) {
+			stats->max_search_path = visited;
+		}
+		++(stats->probes);
+	}
+
+	stats->avg_search_path = (double)total_visited / stats->probes;
+	stats->avg_comparisons = (double)total_comparisons / stats->probes;
+
+	return 0;
+}
+
+#ifdef SKIP_LIST_INSTRUMENT
+
+/* 
+* public function that copies the instrumentation counters of the calling 
+* thread. Only available when built with -DSKIP_LIST_INSTRUMENT.
+*
+* Arguments:
+*	struct skip_list_counters *counters - structure that receives the counters
+*/
+
+void skip_list_counters_get(struct skip_list_counters *counters) {
+	*counters = _sl_counters;
+}
+
+/* 
+* public function that clears the instrumentation counters and latency 
+* histograms of the calling thread.
+*/
+
+void skip_list_counters_reset(void) {
+	struct skip_list_counters empty = {0};
+
+	_sl_counters = empty;
+}
+
+/* 
+* public function that reads a latency percentile from the calling thread's 
+* histogram for one operation.
+*
+* Arguments:
+*	int op - one of SKIP_LIST_OP_INSERT, SKIP_LIST_OP_REMOVE or 
+*		SKIP_LIST_OP_CONTAINS
+*	double percentile - percentile to read, between 0 and 100
+* Returns:
+*	unsigned long long - lower bound in nanoseconds of the bucket holding the
+*		percentile, 0 if no operation was sampled
+*/
+
+unsigned long long skip_list_latency_percentile(int op, double percentile) {
+	unsigned long seen = 0;
+	unsigned long target;
+	int bucket;
+	int msb;
+
+	if(!_sl_counters.samples[op]) {
+		return 0;
+	}
+
+	target = (unsigned long)(percentile / 100.0 * _sl_counters.samples[op]);
+	if(target >= _sl_counters.samples[op]) {
+		target = _sl_counters.samples[op] - 1;
+	}
+
+	for(bucket = 0; bucket < SKIP_LIST_LATENCY_BUCKETS; ++bucket) {
+		seen += _sl_counters.latency[op][bucket];
+		if(seen > target) {
+			break;
+		}
+	}
+
+	if(bucket < 16) {
+		return bucket;
+	}
+
+	msb = bucket / 16 + 3;
+	return (16ULL + bucket % 16) << (msb - 4);
+}
+
+#endif
+
+/*public functions - modification functions*/
+
+/* 
+* public functiion that removes specified data from the skip list.
+*
+* Arguments:
+*	struct skip_list *sl - pointer to skip list
+	void *data - pointer to specifed data the function needs to search for
+* Returns:
+*	int - returns 0 if data did not exist or not removed, 1 if data was 
+*		removed
+*/
+
+int skip_list_remove(struct skip_list *sl, void *data) {
+	struct _sl_node *prev_node;
+	_SL_LATENCY_BEGIN(SKIP_LIST_OP_REMOVE);
+
+	// Find node before where "data" should be
+	prev_node = _search(sl, data);
+
+	// Next node is NULL or next node is not "data"
+	if(!_matches(sl, prev_node->_next_node, data)) {
+		_SL_LATENCY_END(SKIP_LIST_OP_REMOVE);
+		return 0;
+	}
+
+	// Remove node entirely from skip list, a counted node only drops one copy
+	_remove_copy(sl, prev_node->_next_node);
+
+	_SL_LATENCY_END(SKIP_LIST_OP_REMOVE);
+	return 1;
+}
+
+/* 
+* public function that removes one element equal to key, comparing by key 
+* rather than by pointer. In multiset mode this is the same as 
+* skip_list_remove().
+*
+* Arguments:
+*	struct skip_list *sl - pointer to skip list
+*	void *key - pointer to data equal to the element to remove
+* Returns:
+*	int - returns 0 if no element was equal to key, 1 if one was removed
+*/
+
+int skip_list_remove_one(struct skip_list *sl, void *key) {
+	struct _sl_node *current_node;
+
+	current_node = _search(sl, key)->_next_node;
+	if(!current_node || _SL_GT(sl->_gt_func, current_node->_data, key)) {
+		return 0;
+	}
+
+	_remove_copy(sl, current_node);
+	return 1;
+}
+
+/* 
+* public function that removes every element equal to key, comparing by key 
+* rather than by pointer.
+*
+* Arguments:
+*	struct skip_list *sl - pointer to skip list
+*	void *key - pointer to data equal to the elements to remove
+* Returns:
+*	int - returns the number of elements removed
+*/
+
+int skip_list_remove_all(struct skip_list *sl, void *key) {
+	struct _sl_node *current_node;
+	struct _sl_node *next_node;
+	int count = 0;
+
+	current_node = _search(sl, key)->_next_node;
+	while(current_node && !_SL_GT(sl->_gt_func, current_node->_data, key)) {
+		next_node = current_node->_next_node;
+		count += current_node->_count;
+		_remove_tower(sl, current_node);
+		current_node = next_node;
+	}
+
+	return count;
+}
+
+/* 
+* public function that removes every element from lo up to, but not 
+* including, hi. Both boundaries are found in one descent, every sublist is 
+* cut once across the range, and the detached nodes are freed together, so 
+* the cost is O(log n + k) for k removed nodes. The height of the list is 
+* reduced once at the end. Lists ordered by deadline have no gt_func to find
+* the range with and are left alone.
+*
+* Arguments:
+*	struct skip_list *sl - pointer to skip list
+*	void *lo - pointer to data at which the range starts
+*	void *hi - pointer to data at which the range ends
+* Returns:
+*	int - returns the number of elements removed
+*/
+
+int skip_list_remove_range(struct skip_list *sl, void *lo, void *hi) {
+	struct _sl_node *lo_node = sl->_first_node;
+	struct _sl_node *hi_node = sl->_first_node;
+	struct _sl_node *first_node = NULL;
+	struct _sl_node *last_node = NULL;
+	struct _sl_node *base_node = NULL;
+	int hi_behind = 0;
+	int count;
+
+	if(!(sl->_gt_func) || !_SL_GT(sl->_gt_func, hi, lo)) {
+		return 0;
+	}
+
+	while(lo_node) {
+		// lo_node is the last node before lo, hi_node the last before hi
+		while(lo_node->_next_node && _SL_GT(sl->_gt_func, lo, lo_node->_next_node->_data)) {
+			lo_node = lo_node->_next_node;
+		}
+		if(hi_behind) {
+			hi_node = lo_node;
+		}
+		while(hi_node->_next_node && _SL_GT(sl->_gt_func, hi, hi_node->_next_node->_data)) {
+			hi_node = hi_node->_next_node;
+		}
+
+		// cut the sublist between the two
+		if(hi_node != lo_node) {
+			first_node = lo_node->_next_node;
+			last_node = hi_node;
+			lo_node->_next_node = hi_node->_next_node;
+			if(hi_node->_next_node) {
+				hi_node->_next_node->_prev_node = lo_node;
+			}
+		}
+
+		// hi_node can only fall behind lo_node below a level where they met
+		hi_behind = (hi_node == lo_node);
+		base_node = lo_node;
+		lo_node = lo_node->_next_layer;
+		hi_node = hi_node->_next_layer;
+	}
+
+	// the last cut was made on l0, which holds every detached tower
+	if(!first_node) {
+		return 0;
+	}
+
+	count = _free_segment(sl, first_node, last_node, NULL, NULL);
+	sl->_first_node = _reduce_height(sl, sl->_first_node);
+	_refresh_ends(sl);
+	_update_aggregates(sl, base_node);
+	sl->_size -= count;
+
+	return count;
+}
+
+/*public functions - priority queue functions*/
+
+/* 
+* public functions that read the smallest or largest element without removing
+* it. Both ends of l0 are kept by the list, so this is O(1).
+*
+* Arguments:
+*	struct skip_list *sl - pointer to skip list
+*	void **data - receives the element, left untouched if the list is empty
+* Returns:
+*	int - returns 0 if the list is empty, 1 otherwise
+*/
+
+int skip_list_peek_min(struct skip_list *sl, void **data) {
+	if(!(sl->_base_node->_next_node)) {
+		return 0;
+	}
+
+	*data = sl->_base_node->_next_node->_data;
+	return 1;
+}
+
+int skip_list_peek_max(struct skip_list *sl, void **data) {
+	if(!(sl->_last_node)) {
+		return 0;
+	}
+
+	*data = sl->_last_node->_data;
+	return 1;
+}
+
+/* 
+* public functions that remove the smallest or largest element. The node is 
+* first or last on every sublist its tower reaches, so it is unlinked through
+* its own links without searching. In multiset mode one copy is removed.
+*
+* Arguments:
+*	struct skip_list *sl - pointer to skip list
+*	void **data - receives the element, left untouched if the list is empty
+* Returns:
+*	int - returns 0 if the list is empty, 1 otherwise
+*/
+
+int skip_list_pop_min(struct skip_list *sl, void **data) {
+	struct _sl_node *min_node = sl->_base_node->_next_node;
+
+	if(!min_node) {
+		return 0;
+	}
+
+	*data = min_node->_data;
+	_remove_copy(sl, min_node);
+	return 1;
+}
+
+int skip_list_pop_max(struct skip_list *sl, void **data) {
+	struct _sl_node *max_node = sl->_last_node;
+
+	if(!max_node) {
+		return 0;
+	}
+
+	*data = max_node->_data;
+	_remove_copy(sl, max_node);
+	return 1;
+}
+
+/*public functions - aggregate functions*/
+
+/*
+* This private function moves every node above l0 into a whole node, so that
+* the list can keep a key on every level from then on. The new nodes are all
+* allocated before the first one is swapped in, and the list is left as it 
+* was if they cannot be.
+*
+* Arguments:
+*	struct skip_list *sl - pointer to skip list
+* Returns:
+*	int - returns 1 if the nodes are whole, 0 if they could not be allocated
+*/
+int _widen_nodes(struct skip_list *sl) {
+	struct _sl_node **nodes;
+	struct _sl_node *head_node;
+	struct _sl_node *current_node;
+	struct _sl_node *new_node;
+	size_t count = 0;
+	size_t index;
+
+	if(sl->_node_size == sizeof(struct _sl_node)) {
+		return 1;
+	}
+
+	for(head_node = sl->_first_node; head_node->_next_layer; head_node = head_node->_next_layer) {
+		for(current_node = head_node->_next_node; current_node; current_node = current_node->_next_node) {
+			++count;
+		}
+	}
+	nodes = (struct _sl_node **)malloc((count ? count : 1) * sizeof(struct _sl_node *));
+	if(!nodes) {
+		return 0;
+	}
+	for(index = 0; index < count; ++index) {
+		nodes[index] = (struct _sl_node *)_sl_alloc(sl, sizeof(struct _sl_node));
+		if(!nodes[index]) {
+			while(index--) {
+				_sl_free(sl, nodes[index], sizeof(struct _sl_node));
+			}
+			free(nodes);
+			return 0;
+		}
+	}
+
+	// from the top down, so the node above each one has already moved
+	index = 0;
+	for(head_node = sl->_first_node; head_node->_next_layer; head_node = head_node->_next_layer) {
+		for(current_node = head_node->_next_node; current_node; current_node = new_node->_next_node) {
+			new_node = nodes[index++];
+			memcpy(new_node, current_node, _SL_NODE_LINKS);
+			new_node->_count = 1;
+			new_node->_key._markers = NULL;
+
+			new_node->_prev_node->_next_node = new_node;
+			if(new_node->_next_node) {
+				new_node->_next_node->_prev_node = new_node;
+			}
+			if(new_node->_prev_layer) {
+				new_node->_prev_layer->_next_layer = new_node;
+			}
+			new_node->_next_layer->_prev_layer = new_node;
+			_sl_free(sl, current_node, sl->_node_size);
+		}
+	}
+
+	free(nodes);
+	sl->_node_size = sizeof(struct _sl_node);
+	_cache_invalidate(sl);
+
+	return 1;
+}
+
+/* 
+* public function that turns a skip list into an augmented one: every link 
+* then carries the aggregate of the elements it passes over, kept up to date 
+* by every modification. The aggregates of the existing elements are built in
+* O(n); the nodes above l0 of a list that kept no key there are moved into 
+* larger ones first, in O(n) as well. Lists ordered by deadline cannot be 
+* augmented.
+*
+* Arguments:
+*	struct skip_list *sl - pointer to skip list
+*	struct skip_list_monoid *monoid - aggregate to keep, copied into the list
+* Returns:
+*	int - returns 0 if function was executed succesfully, -1 if the larger 
+*		nodes could not be allocated, in which case the list is unchanged
+*/
+
+int skip_list_set_aggregate(struct skip_list *sl, struct skip_list_monoid *monoid) {
+	struct _sl_node *head_node;
+
+	if(!_widen_nodes(sl)) {
+		return -1;
+	}
+	sl->_monoid = *monoid;
+	sl->_aggregate = 1;
+
+	// headers of empty sublists are not reached by the rebuild
+	for(head_node = sl->_first_node; head_node; head_node = head_node->_next_layer) {
+		head_node->_key._agg = monoid->identity;
+	}
+	_rebuild_aggregates(sl);
+
+	return 0;
+}
+
+/* 
+* public function that combines the elements from lo up to, but not 
+* including, hi. Starting from the first element of the range it climbs to the
+* highest link that stays inside the range and descends again near hi, so it
+* combines O(log n) link aggregates instead of walking l0.
+*
+* Arguments:
+*	struct skip_list *sl - pointer to an augmented skip list
+*	void *lo - pointer to data at which the range starts
+*	void *hi - pointer to data at which the range ends
+* Returns:
+*	double - the aggregate of the range, the identity if it is empty
+*/
+
+double skip_list_aggregate(struct skip_list *sl, void *lo, void *hi) {
+	struct _sl_node *current_node;
+	double aggregate = sl->_monoid.identity;
+
+	current_node = _search(sl, lo)->_next_node;
+	while(current_node && _SL_GT(sl->_gt_func, hi, current_node->_data)) {
+		// climb while the link above still ends inside the range
+		while(current_node->_prev_layer && current_node->_prev_layer->_next_node && 
+				!_SL_GT(sl->_gt_func, current_node->_prev_layer->_next_node->_data, hi)) {
+			current_node = current_node->_prev_layer;
+		}
+
+		// descend until this node's link ends inside the range
+		while(current_node->_next_layer && !(current_node->_next_node && 
+				!_SL_GT(sl->_gt_func, current_node->_next_node->_data, hi))) {
+			current_node = current_node->_next_layer;
+		}
+
+		aggregate = sl->_monoid.combine(aggregate, current_node->_key._agg);
+		current_node = current_node->_next_node;
+	}
+
+	return aggregate;
+}
+
+/*public functions - expiry functions*/
+
+/*
+* This private function returns the l0 node after which an entry with the 
+* given deadline goes: the last node whose deadline is not later. Entries with
+* equal deadlines therefore stay in insertion order.
+*/
+struct _sl_node *_find_deadline(struct _sl_node *current_node, long deadline) {
+	for(;;) {
+		while(current_node->_next_node && current_node->_next_node->_key._deadline <= deadline) {
+			current_node = current_node->_next_node;
+		}
+		if(!(current_node->_next_layer)) {
+			return current_node;
+		}
+		current_node = current_node->_next_layer;
+	}
+}
+
+/* 
+* public function that adds an entry that expires at deadline to a list made 
+* by skip_list_create_ttl(). The same item may be added more than once.
+*
+* Arguments:
+*	struct skip_list *sl - pointer to skip list
+*	void *item - pointer to the entry
+*	long deadline - time at which the entry expires, in any unit as long as
+*		skip_list_expire_until() is given the same
+* Returns:
+*	int - returns 1 once the entry has been added, 0 if it could not be 
+*		allocated
+*/
+
+int skip_list_insert_with_deadline(struct skip_list *sl, void *item, long deadline) {
+	struct _sl_node *new_node;
+
+	new_node = _insert_after(sl, _find_deadline(sl->_first_node, deadline), item);
+	if(!new_node) {
+		return 0;
+	}
+	for(; new_node; new_node = new_node->_prev_layer) {
+		new_node->_key._deadline = deadline;
+	}
+
+	return 1;
+}
+
+/* 
+* public function that takes back an entry before it expires.
+*
+* Arguments:
+*	struct skip_list *sl - pointer to skip list
+*	void *item - pointer to the entry
+*	long deadline - deadline the entry was added with
+* Returns:
+*	int - returns 0 if the entry was not found, 1 if it was removed
+*/
+
+int skip_list_remove_with_deadline(struct skip_list *sl, void *item, long deadline) {
+	struct _sl_node *current_node;
+
+	// walk back over the entries sharing the deadline
+	current_node = _find_deadline(sl->_first_node, deadline);
+	for(; current_node->_prev_node && current_node->_key._deadline == deadline; current_node = current_node->_prev_node) {
+		if(current_node->_data == item) {
+			_remove_tower(sl, current_node);
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+/* 
+* public function that removes every entry whose deadline is not later than 
+* now. The expired entries are a prefix of the list, so each sublist is cut 
+* from its header once and the detached nodes are freed together: a sweep 
+* costs O(log n + k) for k expired entries.
+*
+* Arguments:
+*	struct skip_list *sl - pointer to skip list
+*	long now - current time
+*	void (*expired)(void *, void *) - called with every expired entry and 
+*		ctx, in deadline order, may be NULL
+*	void *ctx - pointer passed through to expired
+* Returns:
+*	int - returns the number of entries removed
+*/
+
+int skip_list_expire_until(struct skip_list *sl, long now, void (*expired)(void *, void *), void *ctx) {
+	struct _sl_node *head_node = sl->_first_node;
+	struct _sl_node *current_node = sl->_first_node;
+	struct _sl_node *first_node = NULL;
+	struct _sl_node *last_node = NULL;
+	int count;
+
+	while(head_node) {
+		while(current_node->_next_node && current_node->_next_node->_key._deadline <= now) {
+			current_node = current_node->_next_node;
+		}
+
+		// cut the expired prefix off this sublist
+		if(current_node != head_node) {
+			first_node = head_node->_next_node;
+			last_node = current_node;
+			head_node->_next_node = current_node->_next_node;
+			if(current_node->_next_node) {
+				current_node->_next_node->_prev_node = head_node;
+			}
+		}
+
+		head_node = head_node->_next_layer;
+		current_node = current_node->_next_layer;
+	}
+
+	if(!first_node) {
+		return 0;
+	}
+
+	// the last cut was made on l0, which holds every detached tower
+	count = _free_segment(sl, first_node, last_node, expired, ctx);
+	sl->_first_node = _reduce_height(sl, sl->_first_node);
+	_refresh_ends(sl);
+	sl->_size -= count;
+
+	return count;
+}
+
+/*public functions - interval functions*/
+
+/*
+* This private function allocates count markers into a reserve chained 
+* through _next, so that an operation can allocate everything it needs before
+* it changes the list. Returns 1 if they were allocated, 0 with the reserve 
+* left empty otherwise.
+*/
+int _marker_reserve(struct skip_list *sl, struct _sl_marker **reserve, int count) {
+	struct _sl_marker *marker;
+
+	*reserve = NULL;
+	for(; count > 0; --count) {
+		marker = (struct _sl_marker *)_sl_alloc(sl, sizeof(struct _sl_marker));
+		if(!marker) {
+			while(*reserve) {
+				marker = *reserve;
+				*reserve = marker->_next;
+				_sl_free(sl, marker, sizeof(struct _sl_marker));
+			}
+			return 0;
+		}
+		marker->_next = *reserve;
+		*reserve = marker;
+	}
+
+	return 1;
+}
+
+/*
+* This private function takes a marker from a reserve and adds it to a marker
+* list, with the given kind for an interval.
+*/
+void _marker_add(struct _sl_marker **reserve, struct _sl_marker **markers, struct skip_list_interval *interval, int kind) {
+	struct _sl_marker *marker = *reserve;
+
+	*reserve = marker->_next;
+	marker->_interval = interval;
+	marker->_kind = kind;
+	marker->_next = *markers;
+	*markers = marker;
+}
+
+/*
+* This private function removes the marker of the given kind for an interval
+* from a marker list of sl. Returns 1 if it was found, 0 otherwise.
+*/
+int _marker_remove(struct skip_list *sl, struct _sl_marker **markers, struct skip_list_interval *interval, int kind) {
+	struct _sl_marker *marker;
+
+	for(; *markers; markers = &((*markers)->_next)) {
+		if((*markers)->_interval == interval && (*markers)->_kind == kind) {
+			marker = *markers;
+			*markers = marker->_next;
+			_sl_free(sl, marker, sizeof(struct _sl_marker));
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+/*
+* This private function calls visit with the item of every interval that has a
+* marker of the given kind in a marker list. Returns the number of intervals.
+*/
+int _marker_visit(struct _sl_marker *marker, int kind, void (*visit)(void *, void *), void *ctx) {
+	int count = 0;
+
+	for(; marker; marker = marker->_next) {
+		if(marker->_kind == kind) {
+			if(visit) {
+				visit(marker->_interval->item, ctx);
+			}
+			++count;
+		}
+	}
+
+	return count;
+}
+
+/*
+* This private function returns the l0 node of an endpoint, adding the node if
+* no interval ends there yet, and counts one more reference to it. A new node
+* splits links that intervals may span, so each of its tower nodes takes a
+* copy of the edge markers of the node before it on the same level.
+*
+* Arguments:
+*	struct skip_list *sl - pointer to an interval skip list
+*	void *key - pointer to the endpoint
+* Return:
+*	struct _sl_node * - the l0 node of the endpoint, NULL if it could not be
+*		allocated, in which case the list is left as it was
+*/
+struct _sl_node *_interval_endpoint(struct skip_list *sl, void *key) {
+	struct _sl_node *prev_node;
+	struct _sl_node *tower_node;
+	struct _sl_marker *marker;
+	struct _sl_marker *reserve;
+	int count = 0;
+
+	prev_node = _search(sl, key);
+	if(_matches(sl, prev_node->_next_node, key)) {
+		++(prev_node->_next_node->_count);
+		++(sl->_size);
+		return prev_node->_next_node;
+	}
+
+	prev_node = _insert_after(sl, prev_node, key);
+	if(!prev_node) {
+		return NULL;
+	}
+	for(tower_node = prev_node; tower_node; tower_node = tower_node->_prev_layer) {
+		for(marker = tower_node->_prev_node->_key._markers; marker; marker = marker->_next) {
+			count += marker->_kind == _SL_MARK_EDGE;
+		}
+	}
+	if(!_marker_reserve(sl, &reserve, count)) {
+		_remove_tower(sl, prev_node);	// the links it split join up again
+		return NULL;
+	}
+
+	for(tower_node = prev_node; tower_node; tower_node = tower_node->_prev_layer) {
+		for(marker = tower_node->_prev_node->_key._markers; marker; marker = marker->_next) {
+			if(marker->_kind == _SL_MARK_EDGE) {
+				_marker_add(&reserve, &(tower_node->_key._markers), marker->_interval, _SL_MARK_EDGE);
+			}
+		}
+	}
+
+	return prev_node;
+}
+
+/*
+* This private function returns the node after current_node on its sublist,
+* stepping over the tower of skip as if it had already been removed.
+*/
+struct _sl_node *_interval_next(struct _sl_node *current_node, void *skip) {
+	current_node = current_node->_next_node;
+	if(skip && current_node && current_node->_data == skip) {
+		current_node = current_node->_next_node;
+	}
+
+	return current_node;
+}
+
+/*
+* This private function finds the links that cover an interval from lo up to
+* hi and marks them with markers taken from reserve, or only counts them when
+* reserve is NULL. Like skip_list_aggregate() it takes the highest link that 
+* does not pass hi at every step, so an interval is marked on O(log n) links 
+* and no two of them overlap. The links are those the list will have once the
+* tower of skip, if not NULL, is removed, so that the markers needed 
+* afterwards can be counted before the tower goes.
+*
+* Arguments:
+*	struct skip_list *sl - pointer to an interval skip list
+*	struct skip_list_interval *interval - interval whose endpoints are
+*		already in the list
+*	void *skip - key of a tower to step over, NULL for none
+*	struct _sl_marker **reserve - markers to mark the links with, NULL to
+*		count them
+* Return:
+*	int - number of links that cover the interval
+*/
+int _interval_cover(struct skip_list *sl, 
+		struct skip_list_interval *interval, 
+		void *skip, 
+		struct _sl_marker **reserve
+) {
+	struct _sl_node *current_node;
+	int count = 0;
+
+	current_node = _search(sl, interval->lo)->_next_node;
+	while(_SL_GT(sl->_gt_func, interval->hi, current_node->_data)) {
+		// climb while the link above still ends inside the interval
+		while(current_node->_prev_layer && _interval_next(current_node->_prev_layer, skip) &&
+				!_SL_GT(sl->_gt_func, _interval_next(current_node->_prev_layer, skip)->_data, interval->hi)) {
+			current_node = current_node->_prev_layer;
+		}
+
+		// descend until this node's link ends inside the interval
+		while(current_node->_next_layer && !(_interval_next(current_node, skip) &&
+				!_SL_GT(sl->_gt_func, _interval_next(current_node, skip)->_data, interval->hi))) {
+			current_node = current_node->_next_layer;
+		}
+
+		if(reserve) {
+			_marker_add(reserve, &(current_node->_key._markers), interval, _SL_MARK_EDGE);
+		}
+		++count;
+		current_node = _interval_next(current_node, skip);
+	}
+
+	return count;
+}
+
+/*
+* This private function takes an interval's markers off the links that cover
+* it. Links may have been split since the interval was placed, so the covering
+* is followed from lo: at every node the tower is searched for the marked link.
+*
+* Arguments:
+*	struct skip_list *sl - pointer to an interval skip list
+*	struct skip_list_interval *interval - interval placed in the list
+*/
+void _interval_unplace(struct skip_list *sl, struct skip_list_interval *interval) {
+	struct _sl_node *current_node;
+	struct _sl_node *tower_node;
+
+	current_node = _search(sl, interval->lo)->_next_node;
+	while(_SL_GT(sl->_gt_func, interval->hi, current_node->_data)) {
+		tower_node = current_node;
+		while(!_marker_remove(sl, &(tower_node->_key._markers), interval, _SL_MARK_EDGE)) {
+			tower_node = tower_node->_prev_layer;
+		}
+
+		// continue from the l0 node the marked link ends at
+		for(current_node = tower_node->_next_node; current_node->_next_layer; current_node = current_node->_next_layer);
+	}
+}
+
+/*
+* This private function adds the intervals with edge markers in a marker list
+* to an array of distinct intervals, growing the array as needed. Returns 0 
+* if the array could not grow, 1 otherwise.
+*/
+int _interval_collect(struct _sl_marker *marker,
+		struct skip_list_interval ***intervals,
+		int *count,
+		int *capacity
+) {
+	struct skip_list_interval **grown;
+	int i;
+
+	for(; marker; marker = marker->_next) {
+		if(marker->_kind != _SL_MARK_EDGE) {
+			continue;
+		}
+		for(i = 0; i < *count && (*intervals)[i] != marker->_interval; ++i);
+		if(i < *count) {
+			continue;
+		}
+
+		if(*count == *capacity) {
+			grown = (struct skip_list_interval **)realloc(*intervals,
+					(*capacity ? *capacity * 2 : 8) * sizeof(struct skip_list_interval *));
+			if(!grown) {
+				return 0;
+			}
+			*intervals = grown;
+			*capacity = *capacity ? *capacity * 2 : 8;
+		}
+		(*intervals)[(*count)++] = marker->_interval;
+	}
+
+	return 1;
+}
+
+/*
+* This private function drops one reference to an endpoint and removes its
+* node once no interval ends there. The links on both sides of the node then
+* join, which would stretch the markers on them past their intervals, so every
+* interval marked on those links is taken off and placed again afterwards. 
+* The markers the new placement needs are allocated first; if they cannot be,
+* the node stays in the list with a count of 0, which no query reports, and 
+* is removed when an endpoint there is released again.
+*
+* Arguments:
+*	struct skip_list *sl - pointer to an interval skip list
+*	struct _sl_node *node - l0 node of the endpoint
+*/
+void _interval_release(struct skip_list *sl, struct _sl_node *node) {
+	struct skip_list_interval **intervals = NULL;
+	struct _sl_node *tower_node;
+	struct _sl_marker *reserve = NULL;
+	int collected = 1;
+	int needed = 0;
+	int count = 0;
+	int capacity = 0;
+	int i;
+
+	--(node->_count);
+	--(sl->_size);
+	if(node->_count) {
+		return;
+	}
+
+	for(tower_node = node; tower_node && collected; tower_node = tower_node->_prev_layer) {
+		collected = _interval_collect(tower_node->_key._markers, &intervals, &count, &capacity) &&
+			_interval_collect(tower_node->_prev_node->_key._markers, &intervals, &count, &capacity);
+	}
+	for(i = 0; collected && i < count; ++i) {
+		needed += _interval_cover(sl, intervals[i], node->_data, NULL);
+	}
+
+	if(collected && _marker_reserve(sl, &reserve, needed)) {
+		for(i = 0; i < count; ++i) {
+			_interval_unplace(sl, intervals[i]);
+		}
+		_remove_tower(sl, node);
+		for(i = 0; i < count; ++i) {
+			_interval_cover(sl, intervals[i], NULL, &reserve);
+		}
+	}
+
+	free(intervals);
+}
+
+/*
+* This private function reports the intervals that contain point and returns
+* the last l0 node whose key is not greater than point. On every level the
+* search stops on the link that spans point, and the markers there are
+* exactly the intervals covering point on that level; intervals that end at
+* point are found on its l0 node.
+*
+* Arguments:
+*	struct skip_list *sl - pointer to an interval skip list
+*	void *point - pointer to the point
+*	void (*visit)(void *, void *) - called with the item of every interval
+*		found and ctx, may be NULL
+*	void *ctx - pointer passed through to visit
+*	int *count - incremented for every interval found
+*/
+struct _sl_node *_interval_stab(struct skip_list *sl,
+		void *point,
+		void (*visit)(void *, void *),
+		void *ctx,
+		int *count
+) {
+	struct _sl_node *current_node = sl->_first_node;
+
+	for(;;) {
+		while(current_node->_next_node && !_SL_GT(sl->_gt_func, current_node->_next_node->_data, point)) {
+			current_node = current_node->_next_node;
+		}
+
+		*count += _marker_visit(current_node->_key._markers, _SL_MARK_EDGE, visit, ctx);
+		if(!(current_node->_next_layer)) {
+			break;
+		}
+		current_node = current_node->_next_layer;
+	}
+
+	if(current_node->_prev_node && !_SL_GT(sl->_gt_func, point, current_node->_data)) {
+		*count += _marker_visit(current_node->_key._markers, _SL_MARK_HI, visit, ctx);
+	}
+
+	return current_node;
+}
+
+/*
+* public function that adds the closed interval [lo, hi] to a list made by
+* skip_list_create_interval(). The endpoints become keys of the list and the
+* interval is marked on the O(log n) links that cover it.
+*
+* Arguments:
+*	struct skip_list *sl - pointer to an interval skip list
+*	void *lo - pointer to the start of the interval
+*	void *hi - pointer to the end of the interval, not less than lo
+*	void *item - pointer reported by the queries that find the interval
+* Returns:
+*	struct skip_list_interval * - handle of the interval, NULL if hi is
+*		less than lo or the interval could not be allocated
+*/
+
+struct skip_list_interval *skip_list_interval_insert(struct skip_list *sl, void *lo, void *hi, void *item) {
+	struct skip_list_interval *interval;
+	struct _sl_node *lo_node;
+	struct _sl_node *hi_node;
+	struct _sl_marker *reserve;
+
+	if(_SL_GT(sl->_gt_func, lo, hi)) {
+		return NULL;
+	}
+
+	interval = (struct skip_list_interval *)_sl_alloc(sl, sizeof(struct skip_list_interval));
+	if(!interval) {
+		return NULL;
+	}
+	interval->lo = lo;
+	interval->hi = hi;
+	interval->item = item;
+
+	// allocate everything first, and give back what was taken if that fails
+	if((lo_node = _interval_endpoint(sl, lo))) {
+		if((hi_node = _interval_endpoint(sl, hi))) {
+			if(_marker_reserve(sl, &reserve, _interval_cover(sl, interval, NULL, NULL) + 2)) {
+				_marker_add(&reserve, &(lo_node->_key._markers), interval, _SL_MARK_LO);
+				_marker_add(&reserve, &(hi_node->_key._markers), interval, _SL_MARK_HI);
+				_interval_cover(sl, interval, NULL, &reserve);
+				return interval;
+			}
+			_interval_release(sl, hi_node);
+		}
+		_interval_release(sl, lo_node);
+	}
+
+	_sl_free(sl, interval, sizeof(struct skip_list_interval));
+	return NULL;
+}
+
+/*
+* public function that removes an interval from an interval skip list and
+* frees its handle. Endpoints no other interval uses are removed as well.
+*
+* Arguments:
+*	struct skip_list *sl - pointer to an interval skip list
+*	struct skip_list_interval *interval - handle returned when the interval
+*		was added
+* Returns:
+*	int - returns 0 if the interval was not found, 1 if it was removed
+*/
+
+int skip_list_interval_remove(struct skip_list *sl, struct skip_list_interval *interval) {
+	struct _sl_node *endpoint_node;
+
+	endpoint_node = _search(sl, interval->lo)->_next_node;
+	if(!_matches(sl, endpoint_node, interval->lo) ||
+			!_marker_remove(sl, &(endpoint_node->_key._markers), interval, _SL_MARK_LO)) {
+		return 0;
+	}
+
+	_interval_unplace(sl, interval);
+	_interval_release(sl, endpoint_node);
+
+	endpoint_node = _search(sl, interval->hi)->_next_node;
+	_marker_remove(sl, &(endpoint_node->_key._markers), interval, _SL_MARK_HI);
+	_interval_release(sl, endpoint_node);
+
+	_sl_free(sl, interval, sizeof(struct skip_list_interval));
+	return 1;
+}
+
+/*
+* public function that finds every interval containing a point. The search
+* for the point passes over every link marked with such an interval, so the
+* query costs O(log n + k) for k intervals found.
+*
+* Arguments:
+*	struct skip_list *sl - pointer to an interval skip list
+*	void *point - pointer to the point
+*	void (*visit)(void *, void *) - called with the item of every interval
+*		found and ctx, may be NULL
+*	void *ctx - pointer passed through to visit
+* Returns:
+*	int - returns the number of intervals found
+*/
+
+int skip_list_stab(struct skip_list *sl, void *point, void (*visit)(void *, void *), void *ctx) {
+	int count = 0;
+
+	_interval_stab(sl, point, visit, ctx, &count);
+	return count;
+}
+
+/*
+* public function that finds every interval overlapping the closed range
+* [lo, hi]: the intervals containing lo, followed by the intervals starting
+* after lo and not after hi, read from the endpoints in the range. Every 
+* endpoint in the range belongs to an interval that is reported, so the query
+* costs O(log n + k) for k intervals found, each reported once.
+*
+* Arguments:
+*	struct skip_list *sl - pointer to an interval skip list
+*	void *lo - pointer to the start of the range
+*	void *hi - pointer to the end of the range
+*	void (*visit)(void *, void *) - called with the item of every interval
+*		found and ctx, may be NULL
+*	void *ctx - pointer passed through to visit
+* Returns:
+*	int - returns the number of intervals found
+*/
+
+int skip_list_overlap(struct skip_list *sl, void *lo, void *hi, void (*visit)(void *, void *), void *ctx) {
+	struct _sl_node *current_node;
+	int count = 0;
+
+	if(_SL_GT(sl->_gt_func, lo, hi)) {
+		return 0;
+	}
+
+	current_node = _interval_stab(sl, lo, visit, ctx, &count)->_next_node;
+	for(; current_node && !_SL_GT(sl->_gt_func, current_node->_data, hi); current_node = current_node->_next_node) {
+		count += _marker_visit(current_node->_key._markers, _SL_MARK_LO, visit, ctx);
+	}
+
+	return count;
+}
+
+/*public functions - multi-version functions*/
+
+/*
+* This private function returns the sequence number below which no snapshot
+* can see a version that has been overwritten: the oldest snapshot's, or the
+* latest sequence number if there is no snapshot.
+*/
+unsigned long long _mvcc_horizon(struct skip_list *sl) {
+	return sl->_snapshots ? sl->_snapshots->sequence : sl->_sequence;
+}
+
+/*
+* This private function finds the version of a key a read at sequence number
+* sequence sees: the newest one not above it. Returns NULL if there is none 
+* or it is a tombstone.
+*/
+struct _sl_version *_mvcc_visible(struct _sl_node *node, unsigned long long sequence) {
+	struct _sl_version *version = node->_key._versions;
+
+	while(version && version->_sequence > sequence) {
+		version = version->_older;
+	}
+
+	return version && !(version->_tombstone) ? version : NULL;
+}
+
+/*
+* This private function frees the versions of a key that no snapshot can see
+* any more: everything older than the newest version at the horizon. When 
+* that version is a tombstone with nothing newer, every read sees the key as 
+* deleted and its tower is removed too.
+*
+* Arguments:
+*	struct skip_list *sl - pointer to skip list
+*	struct _sl_node *node - l0 node of the key
+* Returns:
+*	int - returns the number of versions freed
+*/
+int _mvcc_prune(struct skip_list *sl, struct _sl_node *node) {
+	unsigned long long horizon = _mvcc_horizon(sl);
+	struct _sl_version *version = node->_key._versions;
+	struct _sl_version *older;
+	int count = 0;
+
+	while(version && version->_sequence > horizon) {
+		version = version->_older;
+	}
+	if(!version) {
+		return 0;
+	}
+
+	for(older = version->_older, version->_older = NULL; older; ++count) {
+		version = older;
+		older = older->_older;
+		_sl_free(sl, version, sizeof(struct _sl_version));
+	}
+
+	version = node->_key._versions;
+	if(version->_tombstone && version->_sequence <= horizon) {
+		_sl_free(sl, version, sizeof(struct _sl_version));
+		_remove_tower(sl, node);
+		++count;
+	}
+
+	return count;
+}
+
+/*
+* This private function adds a version to a key, inserting the key if it is 
+* new, and collects the versions the write made unreachable.
+*
+* Arguments:
+*	struct skip_list *sl - pointer to skip list
+*	struct _sl_node *prev_node - l0 node before the key
+*	void *key - pointer to the key
+*	void *value - pointer to the value, ignored for tombstones
+*	int tombstone - 1 to delete the key
+* Returns:
+*	unsigned long long - sequence number of the write, 0 if the version or
+*		the key could not be allocated
+*/
+unsigned long long _mvcc_write(struct skip_list *sl, struct _sl_node *prev_node, void *key, void *value, int tombstone) {
+	struct _sl_version *version = (struct _sl_version *)_sl_alloc(sl, sizeof(struct _sl_version));
+	struct _sl_node *node = prev_node->_next_node;
+	unsigned long long sequence;
+
+	if(!version) {
+		return 0;
+	}
+	if(!_matches(sl, node, key) && !(node = _insert_after(sl, prev_node, key))) {
+		_sl_free(sl, version, sizeof(struct _sl_version));
+		return 0;
+	}
+
+	sequence = ++(sl->_sequence);
+	version->_sequence = sequence;
+	version->_value = tombstone ? NULL : value;
+	version->_tombstone = tombstone;
+	version->_older = node->_key._versions;
+	node->_key._versions = version;
+	_mvcc_prune(sl, node);	// may free a tombstone right away, and the tower with it
+
+	return sequence;
+}
+
+/* 
+* public function that sets key to value in a multi-version skip list. The 
+* value it replaces stays visible to the snapshots taken before.
+*
+* Arguments:
+*	struct skip_list *sl - pointer to multi-version skip list
+*	void *key - pointer to the key
+*	void *value - pointer to the value
+* Returns:
+*	unsigned long long - sequence number of the write, 0 if it could not be
+*		allocated
+*/
+
+unsigned long long skip_list_mvcc_put(struct skip_list *sl, void *key, void *value) {
+	return _mvcc_write(sl, _search(sl, key), key, value, 0);
+}
+
+/* 
+* public function that deletes key from a multi-version skip list by adding
+* a tombstone. Snapshots taken before still see the old value.
+*
+* Arguments:
+*	struct skip_list *sl - pointer to multi-version skip list
+*	void *key - pointer to the key
+* Returns:
+*	unsigned long long - sequence number of the delete, 0 if the key was 
+*		not set or the tombstone could not be allocated
+*/
+
+unsigned long long skip_list_mvcc_delete(struct skip_list *sl, void *key) {
+	struct _sl_node *prev_node = _search(sl, key);
+
+	if(!_matches(sl, prev_node->_next_node, key) || !_mvcc_visible(prev_node->_next_node, sl->_sequence)) {
+		return 0;
+	}
+
+	return _mvcc_write(sl, prev_node, key, NULL, 1);
+}
+
+/* 
+* public function that reads the value of key at a snapshot.
+*
+* Arguments:
+*	struct skip_list *sl - pointer to multi-version skip list
+*	void *key - pointer to the key
+*	struct skip_list_snapshot *snapshot - snapshot to read at, NULL for the
+*		latest values
+*	void **value - receives the value, left untouched if key is not set
+* Returns:
+*	int - returns 1 if key was set at the snapshot, 0 otherwise
+*/
+
+int skip_list_mvcc_get(struct skip_list *sl, void *key, struct skip_list_snapshot *snapshot, void **value) {
+	struct _sl_node *node = _search(sl, key)->_next_node;
+	struct _sl_version *version;
+
+	if(!_matches(sl, node, key)) {
+		return 0;
+	}
+	version = _mvcc_visible(node, snapshot ? snapshot->sequence : sl->_sequence);
+	if(!version) {
+		return 0;
+	}
+
+	*value = version->_value;
+	return 1;
+}
+
+/* 
+* public function that finds the least key greater than key that is set at 
+* a snapshot. Called with the key it returned, it steps through the keys in
+* order; writes made in between are not seen by a snapshot, so a scan over 
+* one sees the list as it was when the snapshot was taken.
+*
+* Arguments:
+*	struct skip_list *sl - pointer to multi-version skip list
+*	struct skip_list_snapshot *snapshot - snapshot to read at, NULL for the
+*		latest values
+*	void *key - pointer to the key to step from, NULL for the first key
+*	void **next_key - receives the key found
+*	void **value - receives its value
+* Returns:
+*	int - returns 1 if a key was found, 0 at the end of the list
+*/
+
+int skip_list_mvcc_next(struct skip_list *sl, struct skip_list_snapshot *snapshot, void *key, void **next_key, void **value) {
+	unsigned long long sequence = snapshot ? snapshot->sequence : sl->_sequence;
+	struct _sl_node *current_node = sl->_base_node->_next_node;
+	struct _sl_version *version;
+
+	if(key) {
+		current_node = _search(sl, key)->_next_node;
+		if(_matches(sl, current_node, key)) {
+			current_node = current_node->_next_node;
+		}
+	}
+
+	for(; current_node; current_node = current_node->_next_node) {
+		if((version = _mvcc_visible(current_node, sequence))) {
+			*next_key = current_node->_data;
+			*value = version->_value;
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+/* 
+* public function that frees every version no snapshot can see any more,
+* along with the keys every snapshot sees as deleted. Writes already do this
+* for the key they write, so only versions held back by snapshots released 
+* since are left for it.
+*
+* Arguments:
+*	struct skip_list *sl - pointer to multi-version skip list
+* Returns:
+*	int - returns the number of versions freed
+*/
+
+int skip_list_mvcc_collect(struct skip_list *sl) {
+	struct _sl_node *current_node = sl->_base_node->_next_node;
+	struct _sl_node *next_node;
+	int count = 0;
+
+	while(current_node) {
+		next_node = current_node->_next_node;
+		count += _mvcc_prune(sl, current_node);
+		current_node = next_node;
+	}
+
+	return count;
+}
+
+/* 
+* public function that takes a snapshot of a multi-version skip list at its
+* latest sequence number. The versions the snapshot sees are kept until it 
+* is released.
+*
+* Arguments:
+*	struct skip_list *sl - pointer to multi-version skip list
+* Returns:
+*	struct skip_list_snapshot * - the snapshot, NULL if it could not be 
+*		allocated
+*/
+
+struct skip_list_snapshot *skip_list_snapshot(struct skip_list *sl) {
+	struct skip_list_snapshot *snapshot = sl->_newest_snapshot;
+
+	// snapshots with nothing written in between share one entry
+	if(snapshot && snapshot->sequence == sl->_sequence) {
+		++(snapshot->_refs);
+		return snapshot;
+	}
+
+	snapshot = (struct skip_list_snapshot *)_sl_alloc(sl, sizeof(struct skip_list_snapshot));
+	if(!snapshot) {
+		return NULL;
+	}
+	snapshot->sequence = sl->_sequence;
+	snapshot->_refs = 1;
+	snapshot->_prev = sl->_newest_snapshot;
+	snapshot->_next = NULL;
+	if(sl->_newest_snapshot) {
+		sl->_newest_snapshot->_next = snapshot;
+	} else {
+		sl->_snapshots = snapshot;
+	}
+	sl->_newest_snapshot = snapshot;
+
+	return snapshot;
+}
+
+/* 
+* public function that releases a snapshot. Releasing the oldest one lets 
+* skip_list_mvcc_collect() free the versions only it could see, and runs it.
+*
+* Arguments:
+*	struct skip_list *sl - pointer to multi-version skip list
+*	struct skip_list_snapshot *snapshot - snapshot to release
+*/
+
+void skip_list_snapshot_release(struct skip_list *sl, struct skip_list_snapshot *snapshot) {
+	if(--(snapshot->_refs)) {
+		return;
+	}
+
+	if(snapshot->_prev) {
+		snapshot->_prev->_next = snapshot->_next;
+	} else {
+		sl->_snapshots = snapshot->_next;
+	}
+	if(snapshot->_next) {
+		snapshot->_next->_prev = snapshot->_prev;
+	} else {
+		sl->_newest_snapshot = snapshot->_prev;
+	}
+
+	if(!(snapshot->_prev)) {
+		skip_list_mvcc_collect(sl);
+	}
+	_sl_free(sl, snapshot, sizeof(struct skip_list_snapshot));
+}
+
+/* 
+* public functiion that inserts specified data from the skip list.
+*
+* Arguments:
+*	struct skip_list *sl - pointer to skip list
+*	void *data - pointer to specifed data the function needs to be added to
+*		the list.
+* Returns:
+*	int - returns 0 if data already existed in the list, 1 if data was 
+*		succesfully added, -1 if the allocator ran out of memory.
+*/
+
+int skip_list_insert(struct skip_list *sl, void *data) {
+	struct _sl_node *prev_node;
+	_SL_LATENCY_BEGIN(SKIP_LIST_OP_INSERT);
+
+	// Find node before where data should be
+	prev_node = _search(sl, data);
+
+	// Next node is not NULL and data is already inside of skip list
+	if(_matches(sl, prev_node->_next_node, data)) {
+		if(sl->_multiset) {
+			++(prev_node->_next_node->_count);
+			++(sl->_size);
+			_update_aggregates(sl, prev_node->_next_node);
+			_SL_LATENCY_END(SKIP_LIST_OP_INSERT);
+			return 1;
+		}
+		_SL_LATENCY_END(SKIP_LIST_OP_INSERT);
+		return 0;
+	}
+    
+	if(!_insert_after(sl, prev_node, data)) {
+		_SL_LATENCY_END(SKIP_LIST_OP_INSERT);
+		return -1;
+	}
+
+	_SL_LATENCY_END(SKIP_LIST_OP_INSERT);
+	return 1;
+}
+
+/*
+* This private function creates an empty list that can take over nodes of sl:
+* same gt_func, modes, allocator and aggregate, and a filter and cache set up
+* like those of sl, if it has them. A multi-version list starts at the
+* sequence number of sl, so the sequence numbers of its keys stay increasing.
+*
+* Arguments:
+*	struct skip_list *sl - pointer to skip list to copy the setup of
+* Return:
+*	struct skip_list * - pointer to a new skip list, NULL if it could not be
+*		allocated
+*/
+struct skip_list *_create_like(struct skip_list *sl) {
+	struct skip_list *new_skip_list = skip_list_create(sl->_gt_func);
+
+	if(!new_skip_list) {
+		return NULL;
+	}
+	new_skip_list->_multiset = sl->_multiset;
+	new_skip_list->_bytes = sl->_bytes;
+	new_skip_list->_interval = sl->_interval;
+	new_skip_list->_first_node->_key._markers = NULL;
+	new_skip_list->_mvcc = sl->_mvcc;
+	new_skip_list->_sequence = sl->_sequence;
+	new_skip_list->_node_size = sl->_node_size;
+
+	if(!skip_list_set_allocator(new_skip_list, &(sl->_allocator)) ||
+			(sl->_aggregate && skip_list_set_aggregate(new_skip_list, &(sl->_monoid))) ||
+			(sl->_filter && !skip_list_set_filter(new_skip_list, sl->_filter->_hash,
+				sl->_filter->_capacity, 1.0 / (1 << sl->_filter->_bits))) ||
+			(sl->_cache && !skip_list_set_cache(new_skip_list, sl->_cache->_hash, (int)(sl->_cache->_mask + 1)))) {
+		skip_list_destroy(new_skip_list);
+		return NULL;
+	}
+
+	return new_skip_list;
+}
+
+/*
+* This private function checks whether two lists can exchange nodes: they
+* compare with the same gt_func and are in the same modes, so the nodes of
+* one carry what the other expects to find in them. Lists ordered by deadline
+* have no gt_func to compare with and never qualify.
+*/
+int _same_mode(struct skip_list *a, struct skip_list *b) {
+	return a->_gt_func && a->_gt_func == b->_gt_func &&
+		a->_multiset == b->_multiset &&
+		a->_bytes == b->_bytes &&
+		a->_interval == b->_interval &&
+		a->_mvcc == b->_mvcc;
+}
+
+/* 
+* public function that moves every element of src into dst. The existing nodes
+* of src are spliced into dst level by level in a single ordered walk, so no 
+* node is allocated and no tower is rebuilt: the cost is O(n + m) instead of 
+* one search per element. Elements of src that are already in dst are freed;
+* in multiset mode their counts are added to the node in dst. Both lists must
+* order their elements with the same gt_func and use the same allocator, and
+* lists in different modes are refused. Interval lists are refused as well, 
+* as the links their markers sit on would change under them, and so are 
+* multi-version lists, whose keys hold chains of versions and snapshots that
+* a merge cannot combine.
+*
+* Arguments:
+*	struct skip_list *dst - pointer to skip list receiving the elements
+*	struct skip_list *src - pointer to skip list giving up its elements, it 
+*		is left empty
+* Returns:
+*	int - returns the number of elements added to dst, -1 if the lists are 
+*		in different modes, are interval, multi-version or deadline lists,
+*		or memory ran out, in which case both keep their elements
+*/
+
+int skip_list_merge(struct skip_list *dst, struct skip_list *src) {
+	struct _sl_node *dst_node;
+	struct _sl_node *src_node;
+	struct _sl_node *run_node;
+	struct _sl_node *next_node;
+	struct _sl_node *dst_head;
+	struct _sl_node *src_head;
+	int duplicates = 0;
+	int src_size;
+	int added;
+
+	if(dst == src) {
+		return 0;
+	}
+	if(!_same_mode(dst, src) || dst->_interval || dst->_mvcc) {
+		return -1;
+	}
+	if(dst->_node_size != src->_node_size && !_widen_nodes(dst->_node_size < src->_node_size ? dst : src)) {
+		return -1;	// the nodes of both end up in dst, so they must be the same size
+	}
+	src_size = skip_list_size(src);
+
+	// dst needs at least as many sublists as src
+	while(_count_levels(dst->_first_node) < _count_levels(src->_first_node)) {
+		if(!_grow_height(dst)) {
+			dst->_first_node = _reduce_height(dst, dst->_first_node);
+			return -1;
+		}
+	}
+
+	// drop the elements of src that dst already holds
+	dst_node = _base_head(dst->_first_node)->_next_node;
+	src_node = _base_head(src->_first_node)->_next_node;
+	while(dst_node && src_node) {
+		if(_SL_GT(dst->_gt_func, src_node->_data, dst_node->_data)) {
+			dst_node = dst_node->_next_node;
+			continue;
+		}
+
+		next_node = src_node->_next_node;
+		for(run_node = dst_node; run_node && !_SL_GT(dst->_gt_func, run_node->_data, src_node->_data); run_node = run_node->_next_node) {
+			if(dst->_multiset) {
+				run_node->_count += src_node->_count;
+				_delete_node(src, src_node);
+				break;
+			}
+			if(run_node->_data == src_node->_data) {
+				duplicates += src_node->_count;
+				_delete_node(src, src_node);
+				break;
+			}
+		}
+		src_node = next_node;
+	}
+
+	// merge the sublists from l0 upward
+	dst_head = _base_head(dst->_first_node);
+	src_head = _base_head(src->_first_node);
+	while(src_head) {
+		_merge_layer(dst->_gt_func, dst_head, src_head);
+		dst_head = dst_head->_prev_layer;
+		src_head = src_head->_prev_layer;
+	}
+
+	// src keeps only its l0 header
+	_truncate_to_base(src);
+
+	dst->_first_node = _reduce_height(dst, dst->_first_node);
+	_refresh_ends(dst);
+	_refresh_ends(src);
+	_rebuild_aggregates(dst);
+	added = src_size - duplicates;
+	dst->_size += added;
+	src->_size = 0;
+	_filter_refresh(dst);
+	_filter_refresh(src);
+	_cache_invalidate(src);
+
+	return added;
+}
+
+/* 
+* public function that splits a skip list in two. Every element that is not
+* less than key is moved to a new list by cutting each sublist's links at the 
+* split point, so only the O(log n) nodes on the search path are touched. 
+* The new list is set up like sl, with the same modes, allocator, aggregate,
+* filter and cache; a filter makes the split O(n), as it is recounted. 
+* Interval lists cannot be split, since intervals may span the split point.
+*
+* Arguments:
+*	struct skip_list *sl - pointer to skip list, keeps the elements less 
+*		than key
+*	void *key - pointer to the data at which the list is split
+* Returns:
+*	struct skip_list * - pointer to a new skip list holding the elements not
+*		less than key, NULL if sl is an interval list, is ordered by 
+*		deadline or the new list could not be allocated, in which case sl
+*		is left as it was
+*/
+
+struct skip_list *skip_list_split(struct skip_list *sl, void *key) {
+	struct skip_list *new_skip_list;
+	struct _sl_node *current_node;
+	struct _sl_node *new_head;
+	int levels = _count_levels(sl->_first_node);
+
+	if(sl->_interval || !(sl->_gt_func) || !(new_skip_list = _create_like(sl))) {
+		return NULL;
+	}
+
+	while(_count_levels(new_skip_list->_first_node) < levels) {
+		if(!_grow_height(new_skip_list)) {
+			skip_list_destroy(new_skip_list);
+			return NULL;
+		}
+	}
+
+	// cut every sublist after the last node less than key
+	current_node = sl->_first_node;
+	new_head = new_skip_list->_first_node;
+	while(current_node) {
+		while(current_node->_next_node && _SL_GT(sl->_gt_func, key, current_node->_next_node->_data)) {
+			current_node = current_node->_next_node;
+		}
+
+		if(current_node->_next_node) {
+			new_head->_next_node = current_node->_next_node;
+			new_head->_next_node->_prev_node = new_head;
+			current_node->_next_node = NULL;
+		}
+
+		current_node = current_node->_next_layer;
+		new_head = new_head->_next_layer;
+	}
+
+	sl->_first_node = _reduce_height(sl, sl->_first_node);
+	new_skip_list->_first_node = _reduce_height(new_skip_list, new_skip_list->_first_node);
+	_refresh_ends(sl);
+	_refresh_ends(new_skip_list);
+	_cache_invalidate(sl);
+	_filter_refresh(new_skip_list);
+	_update_aggregates(sl, sl->_last_node ? sl->_last_node : sl->_base_node);
+	_update_aggregates(new_skip_list, new_skip_list->_base_node);
+
+	// the sizes are only known for free if one side ended up empty
+	if(!(_base_head(new_skip_list->_first_node)->_next_node)) {
+		return new_skip_list;
+	}
+	if(!(_base_head(sl->_first_node)->_next_node)) {
+		new_skip_list->_size = sl->_size;
+		new_skip_list->_size_stale = sl->_size_stale;
+		sl->_size = 0;
+		sl->_size_stale = 0;
+		return new_skip_list;
+	}
+	new_skip_list->_size_stale = 1;
+	sl->_size_stale = 1;
+
+	return new_skip_list;
+}
+
+/* 
+* public function that appends every element of b to a. Every element of a 
+* must be less than every element of b, which is not checked. The sublists 
+* are stitched together at the end of a, touching only the O(log n) nodes on
+* the rightmost path of a. Both lists must use the same allocator, and lists
+* in different modes, whose nodes carry different keys, are refused.
+*
+* Arguments:
+*	struct skip_list *a - pointer to skip list receiving the elements
+*	struct skip_list *b - pointer to skip list giving up its elements, it is
+*		left empty
+* Returns:
+*	int - returns 0 if function was executed succesfully, -1 if the lists 
+*		are in different modes or ordered by deadline, or memory ran out,
+*		in which case both keep their elements
+*/
+
+int skip_list_concat(struct skip_list *a, struct skip_list *b) {
+	struct _sl_node *current_node;
+	struct _sl_node *b_head;
+	struct _sl_node *next_layer;
+	struct _sl_node *seam_node = a->_last_node ? a->_last_node : a->_base_node;
+	int same_monoid = b->_aggregate && 
+		a->_monoid.combine == b->_monoid.combine && 
+		a->_monoid.value == b->_monoid.value;
+
+	if(a == b) {
+		return 0;
+	}
+	if(!_same_mode(a, b)) {
+		return -1;
+	}
+	if(a->_node_size != b->_node_size && !_widen_nodes(a->_node_size < b->_node_size ? a : b)) {
+		return -1;	// the nodes of both end up in a, so they must be the same size
+	}
+
+	while(_count_levels(a->_first_node) != _count_levels(b->_first_node)) {
+		if(!_grow_height(_count_levels(a->_first_node) < _count_levels(b->_first_node) ? a : b)) {
+			a->_first_node = _reduce_height(a, a->_first_node);
+			b->_first_node = _reduce_height(b, b->_first_node);
+			return -1;
+		}
+	}
+
+	// link the last node of every sublist of a to the first node of b's
+	current_node = a->_first_node;
+	b_head = b->_first_node;
+	while(current_node) {
+		while(current_node->_next_node) {
+			current_node = current_node->_next_node;
+		}
+
+		next_layer = current_node->_next_layer;
+		if(b_head->_next_node) {
+			current_node->_next_node = b_head->_next_node;
+			current_node->_next_node->_prev_node = current_node;
+			b_head->_next_node = NULL;
+		}
+
+		current_node = next_layer;
+		b_head = b_head->_next_layer;
+	}
+
+	_truncate_to_base(b);
+	a->_first_node = _reduce_height(a, a->_first_node);
+	_refresh_ends(a);
+	_refresh_ends(b);
+	if(same_monoid) {
+		_update_aggregates(a, seam_node);	// b's own links are still right
+	} else {
+		_rebuild_aggregates(a);
+	}
+	a->_size += b->_size;
+	a->_size_stale |= b->_size_stale;
+	if(a->_sequence < b->_sequence) {
+		a->_sequence = b->_sequence;	// versions of b must stay older than new writes
+	}
+	b->_size = 0;
+	b->_size_stale = 0;
+	_filter_refresh(a);
+	_filter_refresh(b);
+	_cache_invalidate(b);
+
+	return 0;
+}
+
+/*public functions - set operations*/
+
+/* 
+* The set operations compare elements by key: two elements are equal when 
+* neither is greater than the other, even if they are different pointers. Both
+* lists must order their elements with the same gt_func. Results are passed in
+* order to a visit function, or collected into a new list by the variants 
+* without the _each suffix. When an element is in both lists, the one from a 
+* is reported. Lists ordered by deadline have no gt_func to compare with: the
+* _each variants visit nothing for them and the others return NULL. The 
+* galloping _each variants return -1 without visiting anything when their
+* finger cannot be allocated, and the others return NULL then.
+*/
+
+/* 
+* public function that visits the elements of a that are also in b. The 
+* smaller list is walked and the larger one is searched with a finger that 
+* gallops through the upper levels, so skewed sizes m < n cost O(m log(n/m)).
+*
+* Arguments:
+*	struct skip_list *a - pointer to first skip list
+*	struct skip_list *b - pointer to second skip list
+*	void (*visit)(void *, void *) - called with every element and ctx
+*	void *ctx - pointer passed through to visit
+* Returns:
+*	int - returns the number of elements visited, -1 if out of memory
+*/
+
+int skip_list_intersect_each(struct skip_list *a, 
+		struct skip_list *b, 
+		void (*visit)(void *, void *), 
+		void *ctx
+) {
+	struct skip_list *walked = a;
+	struct skip_list *searched = b;
+	struct _sl_finger finger;
+	struct _sl_node *current_node;
+	struct _sl_node *match_node;
+	int count = 0;
+
+	if(!(a->_gt_func)) {
+		return 0;
+	}
+	if(skip_list_size(a) > skip_list_size(b)) {
+		walked = b;
+		searched = a;
+	}
+
+	if(_finger_init(&finger, searched)) {
+		return -1;
+	}
+	current_node = _base_head(walked->_first_node)->_next_node;
+	for(; current_node; current_node = current_node->_next_node) {
+		match_node = _finger_search(&finger, current_node->_data)->_next_node;
+		if(!match_node) {
+			break;
+		}
+		if(_SL_GT(a->_gt_func, match_node->_data, current_node->_data)) {
+			continue;
+		}
+
+		visit(walked == a ? current_node->_data : match_node->_data, ctx);
+		++count;
+	}
+	_finger_finish(&finger);
+
+	return count;
+}
+
+/* 
+* public function that visits the elements that are in a, in b or in both, 
+* each key once. Every element is reported, so this is a linear merge.
+*
+* Arguments:
+*	struct skip_list *a - pointer to first skip list
+*	struct skip_list *b - pointer to second skip list
+*	void (*visit)(void *, void *) - called with every element and ctx
+*	void *ctx - pointer passed through to visit
+* Returns:
+*	int - returns the number of elements visited
+*/
+
+int skip_list_union_each(struct skip_list *a, 
+		struct skip_list *b, 
+		void (*visit)(void *, void *), 
+		void *ctx
+) {
+	struct _sl_node *a_node = _base_head(a->_first_node)->_next_node;
+	struct _sl_node *b_node = _base_head(b->_first_node)->_next_node;
+	int count = 0;
+
+	if(!(a->_gt_func)) {
+		return 0;
+	}
+	while(a_node && b_node) {
+		if(_SL_GT(a->_gt_func, a_node->_data, b_node->_data)) {
+			visit(b_node->_data, ctx);
+			b_node = b_node->_next_node;
+		} else {
+			if(!_SL_GT(a->_gt_func, b_node->_data, a_node->_data)) {
+				b_node = b_node->_next_node;
+			}
+			visit(a_node->_data, ctx);
+			a_node = a_node->_next_node;
+		}
+		++count;
+	}
+
+	for(a_node = a_node ? a_node : b_node; a_node; a_node = a_node->_next_node) {
+		visit(a_node->_data, ctx);
+		++count;
+	}
+
+	return count;
+}
+
+/* 
+* public function that visits the elements of a that are not in b. b is 
+* searched with a galloping finger, so a small a costs O(m log(n/m)).
+*
+* Arguments:
+*	struct skip_list *a - pointer to skip list whose elements are reported
+*	struct skip_list *b - pointer to skip list whose elements are removed
+*	void (*visit)(void *, void *) - called with every element and ctx
+*	void *ctx - pointer passed through to visit
+* Returns:
+*	int - returns the number of elements visited, -1 if out of memory
+*/
+
+int skip_list_difference_each(struct skip_list *a, 
+		struct skip_list *b, 
+		void (*visit)(void *, void *), 
+		void *ctx
+) {
+	struct _sl_finger finger;
+	struct _sl_node *current_node;
+	struct _sl_node *match_node;
+	int count = 0;
+
+	if(!(a->_gt_func)) {
+		return 0;
+	}
+	if(_finger_init(&finger, b)) {
+		return -1;
+	}
+	current_node = _base_head(a->_first_node)->_next_node;
+	for(; current_node; current_node = current_node->_next_node) {
+		match_node = _finger_search(&finger, current_node->_data)->_next_node;
+		if(match_node && !_SL_GT(a->_gt_func, match_node->_data, current_node->_data)) {
+			continue;
+		}
+
+		visit(current_node->_data, ctx);
+		++count;
+	}
+	_finger_finish(&finger);
+
+	return count;
+}
+
+/*
+* This private function collects the result of a set operation into a new 
+* list set up like a by _create_like(). Versions and interval markers are not
+* carried over, so the result of multi-version or interval lists is a list of
+* their keys in multiset mode, each counted once.
+*
+* Arguments:
+*	struct skip_list *a - pointer to first skip list
+*	struct skip_list *b - pointer to second skip list
+*	int (*each)(...) - the _each variant of the set operation
+* Returns:
+*	struct skip_list * - pointer to a new skip list holding the result, NULL
+*		if it or the finger of each could not be allocated
+*/
+struct skip_list *_collect_result(struct skip_list *a, 
+		struct skip_list *b, 
+		int (*each)(struct skip_list *, struct skip_list *, void (*)(void *, void *), void *)
+) {
+	struct skip_list *result;
+	struct _sl_builder builder;
+	int visited;
+
+	if(!(a->_gt_func) || !(result = _create_like(a))) {
+		return NULL;
+	}
+	result->_interval = 0;
+	result->_mvcc = 0;
+
+	_builder_init(&builder, result);
+	visited = each(a, b, _builder_append, &builder);
+	_builder_finish(&builder);
+	if(visited < 0 || builder._failed) {
+		skip_list_destroy(result);
+		return NULL;
+	}
+	_rebuild_aggregates(result);
+
+	return result;
+}
+
+/* 
+* public functions that collect the result of a set operation into a new skip
+* list in the same mode as a, with its gt_func, allocator, aggregate, filter 
+* and cache. The results arrive in order, so they are appended in O(1) 
+* expected time each instead of being inserted.
+*
+* Arguments:
+*	struct skip_list *a - pointer to first skip list
+*	struct skip_list *b - pointer to second skip list
+* Returns:
+*	struct skip_list * - pointer to a new skip list holding the result, NULL
+*		if a is ordered by deadline or the result could not be allocated
+*/
+
+struct skip_list *skip_list_intersect(struct skip_list *a, struct skip_list *b) {
+	return _collect_result(a, b, skip_list_intersect_each);
+}
+
+struct skip_list *skip_list_union(struct skip_list *a, struct skip_list *b) {
+	return _collect_result(a, b, skip_list_union_each);
+}
+
+struct skip_list *skip_list_difference(struct skip_list *a, struct skip_list *b) {
+	return _collect_result(a, b, skip_list_difference_each);
+}
+
+/*public functions - parallel construction*/
+
+/* _sl_build_job
+* The share of one thread in skip_list_build_parallel(): a range of the 
+* input to sort, a pair of sorted runs to merge, or a segment to build a list
+* from.
+*/
+
+struct _sl_build_job {
+	int (*_gt_func)(void *, void *);
+	void **_data;
+	void **_tmp;		// scratch space as large as _data
+	int _lo;
+	int _mid;		// end of the first run when merging
+	int _hi;
+	struct skip_list *_sl;	// list built from the segment, with the seed of its towers
+	int _failed;		// set if the segment could not be built
+};
+
+/*
+* This private function merges the sorted runs data[lo, mid) and 
+* data[mid, hi) through tmp.
+*/
+void _merge_runs(int (*gt_func)(void *, void *), void **data, void **tmp, int lo, int mid, int hi) {
+	int a = lo;
+	int b = mid;
+	int out = lo;
+
+	while(a < mid && b < hi) {
+		tmp[out++] = _SL_GT(gt_func, data[a], data[b]) ? data[b++] : data[a++];
+	}
+	memcpy(&(tmp[out]), &(data[a]), (mid - a) * sizeof(void *));
+	out += mid - a;
+	memcpy(&(tmp[out]), &(data[b]), (hi - b) * sizeof(void *));
+	memcpy(&(data[lo]), &(tmp[lo]), (hi - lo) * sizeof(void *));
+}
+
+/*
+* This private function merge sorts data[lo, hi) using tmp[lo, hi).
+*/
+void _merge_sort(int (*gt_func)(void *, void *), void **data, void **tmp, int lo, int hi) {
+	int mid = lo + (hi - lo) / 2;
+
+	if(hi - lo < 2) {
+		return;
+	}
+	_merge_sort(gt_func, data, tmp, lo, mid);
+	_merge_sort(gt_func, data, tmp, mid, hi);
+	_merge_runs(gt_func, data, tmp, lo, mid, hi);
+}
+
+void *_build_sort(void *arg) {
+	struct _sl_build_job *job = (struct _sl_build_job *)arg;
+
+	_merge_sort(job->_gt_func, job->_data, job->_tmp, job->_lo, job->_hi);
+	return NULL;
+}
+
+void *_build_merge(void *arg) {
+	struct _sl_build_job *job = (struct _sl_build_job *)arg;
+
+	_merge_runs(job->_gt_func, job->_data, job->_tmp, job->_lo, job->_mid, job->_hi);
+	return NULL;
+}
+
+/*
+* This private function builds the list of one segment of the sorted input
+* with a builder of its own, skipping an element that repeats the one before
+* it, also across the start of the segment.
+*/
+void *_build_segment(void *arg) {
+	struct _sl_build_job *job = (struct _sl_build_job *)arg;
+	struct _sl_builder builder;
+
+	if(!(job->_sl)) {
+		job->_failed = 1;
+		return NULL;
+	}
+	_builder_init(&builder, job->_sl);
+	for(int index = job->_lo; index < job->_hi; ++index) {
+		if(!index || job->_data[index] != job->_data[index - 1]) {
+			_builder_append(job->_data[index], &builder);
+		}
+	}
+	_builder_finish(&builder);
+	job->_failed = builder._failed;
+
+	return NULL;
+}
+
+/*
+* This private function runs a job on each of count threads, the first on 
+* the calling thread, and waits for all of them.
+*/
+void _build_run(struct _sl_build_job *jobs, int count, void *(*work)(void *)) {
+	pthread_t *workers = (pthread_t *)malloc(count * sizeof(pthread_t));
+	int *started = (int *)calloc(count, sizeof(int));
+	int index;
+
+	for(index = 1; index < count && workers && started; ++index) {
+		started[index] = !pthread_create(&workers[index], NULL, work, &jobs[index]);
+	}
+	work(&jobs[0]);
+	for(index = 1; index < count; ++index) {
+		if(started && started[index]) {
+			pthread_join(workers[index], NULL);
+		} else {
+			work(&jobs[index]);	// no thread for it, do it here
+		}
+	}
+	free(workers);
+	free(started);
+}
+
+/*
+* public function that builds a skip list from n elements in any order on 
+* the given number of threads. Each thread sorts a slice of the input, the 
+* slices are merged pairwise in parallel rounds, and each thread then builds
+* the towers of one contiguous segment of the sorted elements into a list of
+* its own with a builder. The segments are stitched together level by level
+* with skip_list_concat(), which only walks their rightmost paths. The input
+* array is left as it was; repeated pointers are added once.
+*
+* Arguments:
+*	int (*gt_func)(void *, void *) - pointer to the greater than function
+*	void **data - array of the elements
+*	int n - number of elements
+*	int threads - number of threads to use, 1 builds on the calling thread
+* Returns:
+*	struct skip_list * - pointer to a new skip list holding the elements, 
+*		NULL if the list or the scratch space could not be allocated
+*/
+
+struct skip_list *skip_list_build_parallel(int (*gt_func)(void *, void *), void **data, int n, int threads) {
+	struct skip_list *sl = skip_list_create(gt_func);
+	struct _sl_build_job *jobs;
+	void **sorted;
+	void **tmp;
+	int width;
+	int count;
+	int index;
+
+	if(threads < 1) {
+		threads = 1;
+	}
+	if(threads > n / 1024 + 1) {
+		threads = n / 1024 + 1;	// not worth a thread below a thousand elements each
+	}
+
+	sorted = (void **)malloc((n ? n : 1) * sizeof(void *));
+	tmp = (void **)malloc((n ? n : 1) * sizeof(void *));
+	jobs = (struct _sl_build_job *)calloc(threads, sizeof(struct _sl_build_job));
+	if(!sl || !sorted || !tmp || !jobs) {
+		free(sorted);
+		free(tmp);
+		free(jobs);
+		if(sl) {
+			skip_list_destroy(sl);
+		}
+		return NULL;
+	}
+	memcpy(sorted, data, n * sizeof(void *));
+
+	// sort one slice per thread
+	for(index = 0; index < threads; ++index) {
+		jobs[index]._gt_func = gt_func;
+		jobs[index]._data = sorted;
+		jobs[index]._tmp = tmp;
+		jobs[index]._lo = (int)((long long)n * index / threads);
+		jobs[index]._hi = (int)((long long)n * (index + 1) / threads);
+	}
+	_build_run(jobs, threads, _build_sort);
+
+	// merge neighbouring runs, halving their number every round
+	for(width = 1; width < threads; width *= 2) {
+		count = 0;
+		for(index = 0; index + width < threads; index += 2 * width) {
+			jobs[count]._gt_func = gt_func;
+			jobs[count]._data = sorted;
+			jobs[count]._tmp = tmp;
+			jobs[count]._lo = (int)((long long)n * index / threads);
+			jobs[count]._mid = (int)((long long)n * (index + width) / threads);
+			jobs[count]._hi = (int)((long long)n * (index + 2 * width < threads ? index + 2 * width : threads) / threads);
+			++count;
+		}
+		_build_run(jobs, count, _build_merge);
+	}
+
+	// build one segment per thread, each into a list of its own
+	for(index = 0; index < threads; ++index) {
+		jobs[index]._lo = (int)((long long)n * index / threads);
+		jobs[index]._hi = (int)((long long)n * (index + 1) / threads);
+		jobs[index]._sl = index ? skip_list_create(gt_func) : sl;
+	}
+	_build_run(jobs, threads, _build_segment);
+
+	for(index = 1; index < threads; ++index) {
+		if(jobs[0]._failed || jobs[index]._failed || skip_list_concat(sl, jobs[index]._sl)) {
+			jobs[0]._failed = 1;
+		}
+		if(jobs[index]._sl) {
+			skip_list_destroy(jobs[index]._sl);
+		}
+	}
+	if(jobs[0]._failed) {
+		skip_list_destroy(sl);
+		sl = NULL;
+	}
+
+	free(sorted);
+	free(tmp);
+	free(jobs);
+
+	return sl;
+}
+
+/*public functions - parallel scans*/
+
+/* _sl_scan
+* A range scan shared by the threads of skip_list_parallel_for_each(). The
+* range is cut at the l0 nodes below the nodes of one upper sublist into 
+* about _SL_SCAN_CHUNKS chunks per thread, and every thread keeps taking the
+* next chunk nobody has taken, so threads that land on cheap chunks help with
+* the rest.
+*/
+
+#define _SL_SCAN_CHUNKS 8
+
+struct _sl_scan {
+	struct _sl_node **_cuts;	// first l0 node of every chunk, then the end
+	int _chunks;
+	int _next_chunk;	// next chunk to hand out
+	int _count;		// elements visited
+	void (*_visit)(void *, void *);
+	void *_ctx;
+};
+
+/*
+* This private function visits the elements of chunks until none is left, 
+* prefetching two nodes ahead.
+*/
+void *_scan_chunks(void *arg) {
+	struct _sl_scan *scan = (struct _sl_scan *)arg;
+	struct _sl_node *current_node;
+	struct _sl_node *end_node;
+	int chunk;
+	int count = 0;
+
+	while((chunk = __atomic_fetch_add(&(scan->_next_chunk), 1, __ATOMIC_RELAXED)) < scan->_chunks) {
+		end_node = scan->_cuts[chunk + 1];
+		for(current_node = scan->_cuts[chunk]; current_node != end_node; current_node = current_node->_next_node) {
+			if(current_node->_next_node) {
+				__builtin_prefetch(current_node->_next_node->_next_node);
+				__builtin_prefetch(current_node->_next_node->_data);
+			}
+			scan->_visit(current_node->_data, scan->_ctx);
+			++count;
+		}
+	}
+	__atomic_fetch_add(&(scan->_count), count, __ATOMIC_RELAXED);
+
+	return NULL;
+}
+
+/*
+* This private function cuts the elements not less than lo and less than hi
+* into the chunks of a scan for the given number of threads. Every cut is a 
+* different l0 node, in order, so no chunk is empty, and an empty range has
+* no chunks.
+*
+* Arguments:
+*	struct _sl_scan *scan - scan that receives _cuts and _chunks
+*	struct skip_list *sl - pointer to skip list
+*	void *lo - pointer to the least data to visit, NULL for no lower bound
+*	void *hi - pointer to the data to stop at, NULL for no upper bound
+*	int threads - number of threads the scan is cut for
+* Returns:
+*	int - returns 0, or -1 if the cuts could not be allocated
+*/
+int _scan_cut(struct _sl_scan *scan, struct skip_list *sl, void *lo, void *hi, int threads) {
+	struct _sl_node *prev_node;	// last node before lo on the level
+	struct _sl_node *current_node;
+	struct _sl_node *cut_node;
+	struct _sl_node *end_node;
+	int in_range = 0;
+	int index;
+
+	end_node = hi ? _search(sl, hi)->_next_node : NULL;
+
+	// go down until a sublist holds enough nodes inside the range to cut at
+	for(prev_node = sl->_first_node; ; prev_node = prev_node->_next_layer) {
+		while(lo && prev_node->_next_node && _SL_GT(sl->_gt_func, lo, prev_node->_next_node->_data)) {
+			prev_node = prev_node->_next_node;
+		}
+		in_range = 0;
+		for(current_node = prev_node->_next_node; current_node; current_node = current_node->_next_node) {
+			if(hi && !_SL_GT(sl->_gt_func, hi, current_node->_data)) {
+				break;
+			}
+			++in_range;
+		}
+		if(in_range >= _SL_SCAN_CHUNKS * threads || !(prev_node->_next_layer)) {
+			break;
+		}
+	}
+
+	// the first chunk starts at lo, the others below each node of the sublist
+	scan->_cuts = (struct _sl_node **)malloc((in_range + 2) * sizeof(struct _sl_node *));
+	if(!(scan->_cuts)) {
+		return -1;
+	}
+	scan->_cuts[0] = lo ? _search(sl, lo)->_next_node : sl->_base_node->_next_node;
+	scan->_chunks = 1;
+	current_node = prev_node->_next_node;
+	for(index = 0; index < in_range; ++index, current_node = current_node->_next_node) {
+		for(cut_node = current_node; cut_node->_next_layer; cut_node = cut_node->_next_layer);
+		if(cut_node != scan->_cuts[scan->_chunks - 1]) {
+			scan->_cuts[scan->_chunks++] = cut_node;
+		}
+	}
+	scan->_cuts[scan->_chunks] = end_node;
+	if(scan->_cuts[0] == end_node) {
+		scan->_chunks = 0;
+	}
+
+	return 0;
+}
+
+/*
+* public function that calls visit with every element not less than lo and 
+* less than hi on several threads at once. The range is cut at the nodes of
+* the highest sublist that has about _SL_SCAN_CHUNKS nodes per thread inside
+* it, which splits it into chunks of about equal length without walking l0;
+* the threads then share out the chunks as they finish them. visit is called
+* from all the threads, in no particular order, and must not change the list.
+*
+* Arguments:
+*	struct skip_list *sl - pointer to skip list
+*	void *lo - pointer to the least data to visit, NULL for no lower bound
+*	void *hi - pointer to the data to stop at, NULL for no upper bound
+*	void (*visit)(void *, void *) - called with every element and ctx
+*	void *ctx - pointer passed through to visit
+*	int threads - number of threads to use, 1 scans on the calling thread
+* Returns:
+*	int - returns the number of elements visited
+*/
+
+int skip_list_parallel_for_each(struct skip_list *sl, void *lo, void *hi, void (*visit)(void *, void *), void *ctx, int threads) {
+	struct _sl_scan scan;
+	pthread_t *workers;
+	int *started;
+	int index;
+
+	if(lo && hi && !_SL_GT(sl->_gt_func, hi, lo)) {
+		return 0;
+	}
+	if(threads < 1) {
+		threads = 1;
+	}
+	if(_scan_cut(&scan, sl, lo, hi, threads)) {
+		return 0;
+	}
+	scan._next_chunk = 0;
+	scan._count = 0;
+	scan._visit = visit;
+	scan._ctx = ctx;
+
+	if(threads > scan._chunks) {
+		threads = scan._chunks ? scan._chunks : 1;
+	}
+	workers = (pthread_t *)malloc(threads * sizeof(pthread_t));
+	started = (int *)calloc(threads, sizeof(int));
+	for(index = 1; index < threads && workers && started; ++index) {
+		started[index] = !pthread_create(&workers[index], NULL, _scan_chunks, &scan);
+	}
+	_scan_chunks(&scan);
+	for(index = 1; index < threads && workers && started; ++index) {
+		if(started[index]) {
+			pthread_join(workers[index], NULL);
+		}
+	}
+
+	free(workers);
+	free(started);
+	free(scan._cuts);
+
+	return scan._count;
+}
+
+/*public functions - intrusive skip lists*/
+
+/*
+* This private function returns the link slot of a hook on a level, which is 
+* the head of the level for a NULL hook.
+*/
+struct skip_list_hook **_hook_link(struct skip_list_intrusive *sl, struct skip_list_hook *hook, int level) {
+	if(!hook) {
+		return &(sl->_head[level]);
+	}
+	if(level < SKIP_LIST_HOOK_INLINE) {
+		return &(hook->_next[level]);
+	}
+
+	return &(hook->_tower[level - SKIP_LIST_HOOK_INLINE]);
+}
+
+/*
+* This private function returns the element a hook is embedded in.
+*/
+void *_hook_item(struct skip_list_intrusive *sl, struct skip_list_hook *hook) {
+	return (char *)hook - sl->_offset;
+}
+
+/*
+* This private function searches an intrusive list for the first element not
+* less than item and stores, for every level, the link slot that leads to it.
+*
+* Arguments:
+*	struct skip_list_intrusive *sl - pointer to intrusive skip list
+*	void *item - pointer to the element searched for
+*	struct skip_list_hook ***links - filled with one slot per level
+* Returns:
+*	struct skip_list_hook * - hook of the last element less than item on 
+*		l0, NULL if there is none
+*/
+struct skip_list_hook *_hook_search(struct skip_list_intrusive *sl, void *item, struct skip_list_hook ***links) {
+	struct skip_list_hook *prev_hook = NULL;
+	struct skip_list_hook *next_hook;
+	int level;
+
+	for(level = sl->_levels - 1; level >= 0; --level) {
+		for(;;) {
+			next_hook = *_hook_link(sl, prev_hook, level);
+			if(!next_hook || !_SL_GT(sl->_gt_func, item, _hook_item(sl, next_hook))) {
+				break;
+			}
+			prev_hook = next_hook;
+			_SL_COUNT(nodes_visited);
+		}
+		links[level] = _hook_link(sl, prev_hook, level);
+		_SL_COUNT(levels_descended);
+	}
+
+	return prev_hook;
+}
+
+/*
+* public function that initializes a new intrusive skip list. Its elements 
+* embed a struct skip_list_hook at hook_offset, so inserting and removing one
+* only allocates for the rare towers taller than SKIP_LIST_HOOK_INLINE, and 
+* gt_func reads the keys next to the links it just followed. The list never 
+* owns its elements.
+*
+* Arguments:
+*	int (*gt_func)(void *, void *) - pointer to the greater than function,
+*		called with pointers to elements
+*	size_t hook_offset - offsetof() the hook in the elements
+* Returns:
+*	struct skip_list_intrusive * - pointer to a new intrusive skip list, 
+*		NULL if it could not be allocated
+*/
+
+struct skip_list_intrusive *skip_list_intrusive_create(int (*gt_func)(void *, void *), size_t hook_offset) {
+	struct skip_list_intrusive *new_skip_list;
+
+	new_skip_list = (struct skip_list_intrusive *)calloc(1, sizeof(struct skip_list_intrusive));
+	if(!new_skip_list) {
+		return NULL;
+	}
+	_SL_COUNT(allocations);
+	new_skip_list->_gt_func = gt_func;
+	new_skip_list->_offset = hook_offset;
+	new_skip_list->_levels = 1;
+	new_skip_list->_seed = _seed_new();
+
+	return new_skip_list;
+}
+
+/*
+* public function that dealocates an intrusive skip list. The elements are 
+* left to the caller; only the towers the list allocated for them are freed.
+*
+* Arguments:
+*	struct skip_list_intrusive *sl - pointer to intrusive skip list
+*/
+
+void skip_list_intrusive_destroy(struct skip_list_intrusive *sl) {
+	struct skip_list_hook *hook;
+
+	for(hook = sl->_head[0]; hook; hook = hook->_next[0]) {
+		if(hook->_tower) {
+			free(hook->_tower);
+			_SL_COUNT(frees);
+		}
+	}
+
+	free(sl);
+	_SL_COUNT(frees);
+}
+
+/*
+* public function that inserts an element into an intrusive skip list. The 
+* height of its tower is decided by _coin_flip() as for the other lists; the 
+* first SKIP_LIST_HOOK_INLINE levels are linked through the hook itself and 
+* the rest are malloc()ed. An intrusive list has no struct skip_list, so no
+* skip_list_allocator to take them from, and its elements come from the 
+* caller anyway.
+*
+* Arguments:
+*	struct skip_list_intrusive *sl - pointer to intrusive skip list
+*	void *item - pointer to the element, whose hook is not in any list
+* Returns:
+*	int - returns 0 if an equal element is already in the list, 1 if item 
+*		was added, -1 if its tower could not be allocated, in which case 
+*		the list is left as it was
+*/
+
+int skip_list_intrusive_insert(struct skip_list_intrusive *sl, void *item) {
+	struct skip_list_hook **links[SKIP_LIST_HOOK_LEVELS];
+	struct skip_list_hook *hook = (struct skip_list_hook *)((char *)item + sl->_offset);
+	struct skip_list_hook *prev_hook;
+	int level;
+
+	prev_hook = _hook_search(sl, item, links);
+	if(*links[0] && !_SL_GT(sl->_gt_func, _hook_item(sl, *links[0]), item)) {
+		return 0;
+	}
+
+	for(hook->_height = 1; hook->_height < SKIP_LIST_HOOK_LEVELS && _coin_flip(&(sl->_seed)); ++(hook->_height));
+	hook->_tower = NULL;
+	if(hook->_height > SKIP_LIST_HOOK_INLINE) {
+		hook->_tower = (struct skip_list_hook **)malloc((hook->_height - SKIP_LIST_HOOK_INLINE) * sizeof(struct skip_list_hook *));
+		if(!(hook->_tower)) {
+			return -1;
+		}
+		_SL_COUNT(allocations);
+	}
+
+	// a taller tower starts new levels from their heads
+	for(; sl->_levels < hook->_height; ++(sl->_levels)) {
+		links[sl->_levels] = &(sl->_head[sl->_levels]);
+	}
+
+	for(level = 0; level < hook->_height; ++level) {
+		*_hook_link(sl, hook, level) = *links[level];
+		*links[level] = hook;
+	}
+
+	hook->_prev = prev_hook;
+	if(hook->_next[0]) {
+		hook->_next[0]->_prev = hook;
+	} else {
+		sl->_last = hook;
+	}
+	++(sl->_size);
+
+	return 1;
+}
+
+/*
+* public function that removes an element from an intrusive skip list.
+*
+* Arguments:
+*	struct skip_list_intrusive *sl - pointer to intrusive skip list
+*	void *item - pointer to the element
+* Returns:
+*	int - returns 0 if item was not in the list, 1 if it was removed
+*/
+
+int skip_list_intrusive_remove(struct skip_list_intrusive *sl, void *item) {
+	struct skip_list_hook **links[SKIP_LIST_HOOK_LEVELS];
+	struct skip_list_hook *hook = (struct skip_list_hook *)((char *)item + sl->_offset);
+	int level;
+
+	_hook_search(sl, item, links);
+	if(*links[0] != hook) {
+		return 0;
+	}
+
+	for(level = 0; level < hook->_height; ++level) {
+		*links[level] = *_hook_link(sl, hook, level);
+	}
+
+	if(hook->_next[0]) {
+		hook->_next[0]->_prev = hook->_prev;
+	} else {
+		sl->_last = hook->_prev;
+	}
+	if(hook->_tower) {
+		free(hook->_tower);
+		_SL_COUNT(frees);
+		hook->_tower = NULL;
+	}
+
+	while(sl->_levels > 1 && !(sl->_head[sl->_levels - 1])) {
+		--(sl->_levels);
+	}
+	--(sl->_size);
+
+	return 1;
+}
+
+/*
+* public function that finds the element of an intrusive skip list equal to
+* key.
+*
+* Arguments:
+*	struct skip_list_intrusive *sl - pointer to intrusive skip list
+*	void *key - pointer to an element holding the key searched for, which
+*		does not have to be in the list
+* Returns:
+*	void * - the element found, NULL if there is none
+*/
+
+void *skip_list_intrusive_find(struct skip_list_intrusive *sl, void *key) {
+	struct skip_list_hook **links[SKIP_LIST_HOOK_LEVELS];
+	void *item;
+
+	_hook_search(sl, key, links);
+	if(!(*links[0])) {
+		return NULL;
+	}
+
+	item = _hook_item(sl, *links[0]);
+	return _SL_GT(sl->_gt_func, item, key) ? NULL : item;
+}
+
+/*
+* public functions that walk an intrusive skip list in order: first and last
+* return its smallest and largest element, next and prev the neighbours of an
+* element in the list. All of them return NULL past either end.
+*/
+
+void *skip_list_intrusive_first(struct skip_list_intrusive *sl) {
+	return sl->_head[0] ? _hook_item(sl, sl->_head[0]) : NULL;
+}
+
+void *skip_list_intrusive_last(struct skip_list_intrusive *sl) {
+	return sl->_last ? _hook_item(sl, sl->_last) : NULL;
+}
+
+void *skip_list_intrusive_next(struct skip_list_intrusive *sl, void *item) {
+	struct skip_list_hook *hook = (struct skip_list_hook *)((char *)item + sl->_offset);
+
+	return hook->_next[0] ? _hook_item(sl, hook->_next[0]) : NULL;
+}
+
+void *skip_list_intrusive_prev(struct skip_list_intrusive *sl, void *item) {
+	struct skip_list_hook *hook = (struct skip_list_hook *)((char *)item + sl->_offset);
+
+	return hook->_prev ? _hook_item(sl, hook->_prev) : NULL;
+}
+
+/*
+* public function that returns the number of elements in an intrusive skip 
+* list.
+*/
+
+int skip_list_intrusive_size(struct skip_list_intrusive *sl) {
+	return sl->_size;
+}
+
+/*public functions - compact skip lists*/
+
+/*
+* This private function returns the node of a compact list at an index.
+*/
+struct _sl_cnode *_cnode(struct skip_list_compact *sl, uint32_t index) {
+	return &(sl->_chunks[index >> sl->_shift][index & ((1u << sl->_shift) - 1)]);
+}
+
+/*
+* This private function allocates a chunk of a compact list's arena. Lists
+* that asked for huge pages map their chunks, trying 1GB then 2MB hugetlbfs 
+* pages down from the mode asked for, and then regular pages with a request
+* for transparent huge pages. The list's page mode drops to the best mode 
+* the chunk got, so later chunks don't retry what already failed.
+*
+* Arguments:
+*	struct skip_list_compact *sl - pointer to compact skip list
+* Returns:
+*	struct _sl_cnode * - base of the chunk, NULL if it could not be allocated
+*/
+struct _sl_cnode *_chunk_alloc(struct skip_list_compact *sl) {
+	size_t length = ((size_t)1 << sl->_shift) * sizeof(struct _sl_cnode);
+	void *chunk;
+
+	if(!(sl->_mapped)) {
+		return (struct _sl_cnode *)malloc(length);
+	}
+
+#ifdef MAP_HUGETLB
+	if(sl->_page_mode == SKIP_LIST_PAGES_HUGE_1G) {
+		chunk = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | (30 << MAP_HUGE_SHIFT), -1, 0);
+		if(chunk != MAP_FAILED) {
+			return (struct _sl_cnode *)chunk;
+		}
+		sl->_page_mode = SKIP_LIST_PAGES_HUGE_2M;
+	}
+	if(sl->_page_mode == SKIP_LIST_PAGES_HUGE_2M) {
+		chunk = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | (21 << MAP_HUGE_SHIFT), -1, 0);
+		if(chunk != MAP_FAILED) {
+			return (struct _sl_cnode *)chunk;
+		}
+		sl->_page_mode = SKIP_LIST_PAGES_THP;
+	}
+#else
+	if(sl->_page_mode > SKIP_LIST_PAGES_THP) {
+		sl->_page_mode = SKIP_LIST_PAGES_THP;
+	}
+#endif
+
+	chunk = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if(chunk == MAP_FAILED) {
+		return NULL;
+	}
+#ifdef MADV_HUGEPAGE
+	if(sl->_page_mode == SKIP_LIST_PAGES_THP && madvise(chunk, length, MADV_HUGEPAGE)) {
+		sl->_page_mode = SKIP_LIST_PAGES_DEFAULT;
+	}
+#else
+	sl->_page_mode = SKIP_LIST_PAGES_DEFAULT;
+#endif
+	return (struct _sl_cnode *)chunk;
+}
+
+/*
+* This private function takes a node from the arena of a compact list: a 
+* freed one if there is any, the next unused one otherwise, adding a chunk 
+* when the last one is full. The node is cleared.
+*
+* Arguments:
+*	struct skip_list_compact *sl - pointer to compact skip list
+* Returns:
+*	uint32_t - index of the node, 0 if the arena is at its limit or a 
+*		chunk could not be allocated
+*/
+uint32_t _cnode_alloc(struct skip_list_compact *sl) {
+	struct _sl_cnode **chunks;
+	uint32_t index = sl->_free;
+
+	if(index) {
+		sl->_free = _cnode(sl, index)->_next_node;
+	} else {
+		if(sl->_used == sl->_limit) {
+			return 0;
+		}
+		index = sl->_used + 1;
+
+		if((index >> sl->_shift) == sl->_chunk_count) {
+			chunks = (struct _sl_cnode **)realloc(sl->_chunks, (sl->_chunk_count + 1) * sizeof(struct _sl_cnode *));
+			if(!chunks) {
+				return 0;
+			}
+			sl->_chunks = chunks;
+			sl->_chunks[sl->_chunk_count] = _chunk_alloc(sl);
+			if(!(sl->_chunks[sl->_chunk_count])) {
+				return 0;
+			}
+			++(sl->_chunk_count);
+			_SL_COUNT(allocations);
+		}
+		sl->_used = index;
+	}
+
+	memset(_cnode(sl, index), 0, sizeof(struct _sl_cnode));
+	return index;
+}
+
+/*
+* This private function gives a node back to the arena of a compact list.
+*/
+void _cnode_free(struct skip_list_compact *sl, uint32_t index) {
+	_cnode(sl, index)->_next_node = sl->_free;
+	sl->_free = index;
+}
+
+/*
+* This private function is _find_previous() for compact lists.
+*
+* Arguments:
+*	struct skip_list_compact *sl - pointer to compact skip list
+*	void *data - pointer to the data we are searching for
+* Returns:
+*	uint32_t - index of the last l0 node less than data
+*/
+uint32_t _compact_find_previous(struct skip_list_compact *sl, void *data) {
+	uint32_t current = sl->_first_node;
+	struct _sl_cnode *current_node = _cnode(sl, current);
+
+	for(;;) {
+		while(current_node->_next_node && _SL_GT(sl->_gt_func, data, _cnode(sl, current_node->_next_node)->_data)) {
+			current = current_node->_next_node;
+			current_node = _cnode(sl, current);
+			_SL_COUNT(nodes_visited);
+		}
+		if(!(current_node->_next_layer)) {
+			return current;
+		}
+		current = current_node->_next_layer;
+		current_node = _cnode(sl, current);
+		_SL_COUNT(levels_descended);
+	}
+}
+
+/*
+* This private function links a node taken from the arena after prev on its
+* sublist and on top of below in its tower.
+*/
+void _compact_link(struct skip_list_compact *sl, uint32_t index, uint32_t prev, uint32_t below, void *data) {
+	struct _sl_cnode *new_node = _cnode(sl, index);
+	struct _sl_cnode *prev_node = _cnode(sl, prev);
+
+	new_node->_data = data;
+	new_node->_prev_node = prev;
+	new_node->_next_node = prev_node->_next_node;
+	new_node->_next_layer = below;
+	if(prev_node->_next_node) {
+		_cnode(sl, prev_node->_next_node)->_prev_node = index;
+	}
+	prev_node->_next_node = index;
+	if(below) {
+		_cnode(sl, below)->_prev_layer = index;
+	}
+}
+
+/*
+* This private function initializes a new compact skip list with chunks of 
+* 2^shift nodes and an arena that holds the whole index range. 
+*
+* Arguments:
+*	int (*gt_func)(void *, void *) - pointer to the greater than function
+*	int page_mode - enum skip_list_page_mode to ask for
+*	int shift - log2 of the nodes per chunk
+* Returns:
+*	struct skip_list_compact * - pointer to a new compact skip list, NULL if
+*		it could not be allocated
+*/
+struct skip_list_compact *_compact_create(int (*gt_func)(void *, void *), int page_mode, int shift) {
+	struct skip_list_compact *new_skip_list;
+
+	new_skip_list = (struct skip_list_compact *)calloc(1, sizeof(struct skip_list_compact));
+	if(!new_skip_list) {
+		return NULL;
+	}
+	_SL_COUNT(allocations);
+	new_skip_list->_gt_func = gt_func;
+	new_skip_list->_shift = shift;
+	new_skip_list->_limit = UINT32_MAX;
+	new_skip_list->_mapped = page_mode != SKIP_LIST_PAGES_DEFAULT;
+	new_skip_list->_page_mode = page_mode;
+	new_skip_list->_seed = _seed_new();
+
+	// the header of l0
+	new_skip_list->_first_node = _cnode_alloc(new_skip_list);
+	if(!(new_skip_list->_first_node)) {
+		free(new_skip_list->_chunks);
+		free(new_skip_list);
+		return NULL;
+	}
+
+	return new_skip_list;
+}
+
+/*
+* public function that initializes a new compact skip list whose arena sits
+* on huge pages, so a search down a large list misses the TLB far less often.
+* Huge pages that are not available are quietly replaced by the next smaller 
+* kind, down to regular pages; skip_list_compact_stats() reports what the 
+* list ended up with. hugetlbfs pages have to be reserved by the system 
+* (vm.nr_hugepages, or hugepagesz=1G on the kernel command line) and each
+* chunk takes three of them whole, 6MB or 3GB, however few nodes it holds.
+*
+* Arguments:
+*	int (*gt_func)(void *, void *) - pointer to the greater than function
+*	int page_mode - enum skip_list_page_mode to ask for
+* Returns:
+*	struct skip_list_compact * - pointer to a new compact skip list, NULL if
+*		it could not be allocated
+*/
+
+struct skip_list_compact *skip_list_compact_create_paged(int (*gt_func)(void *, void *), int page_mode) {
+	return _compact_create(gt_func, page_mode, page_mode == SKIP_LIST_PAGES_HUGE_1G ? SKIP_LIST_COMPACT_SHIFT_1G : SKIP_LIST_COMPACT_SHIFT);
+}
+
+/*
+* public function that initializes a new compact skip list. Its nodes hold 
+* the same four links as the nodes of the other lists, but as 32-bit indices 
+* into an arena of fixed size chunks owned by the list, so a node takes 24 
+* bytes instead of 56 and twice as many links share a cache line. The arena 
+* holds up to 2^32 - 1 nodes, counting every level; an insert that would go 
+* past that fails and leaves the list as it was.
+*
+* Arguments:
+*	int (*gt_func)(void *, void *) - pointer to the greater than function
+* Returns:
+*	struct skip_list_compact * - pointer to a new compact skip list, NULL if
+*		it could not be allocated
+*/
+
+struct skip_list_compact *skip_list_compact_create(int (*gt_func)(void *, void *)) {
+	return skip_list_compact_create_paged(gt_func, SKIP_LIST_PAGES_DEFAULT);
+}
+
+/*
+* public function that dealocates a compact skip list and its arena.
+*
+* Arguments:
+*	struct skip_list_compact *sl - pointer to compact skip list
+*/
+
+void skip_list_compact_destroy(struct skip_list_compact *sl) {
+	uint32_t chunk;
+
+	for(chunk = 0; chunk < sl->_chunk_count; ++chunk) {
+		if(sl->_mapped) {
+			munmap(sl->_chunks[chunk], ((size_t)1 << sl->_shift) * sizeof(struct _sl_cnode));
+		} else {
+			free(sl->_chunks[chunk]);
+		}
+		_SL_COUNT(frees);
+	}
+	free(sl->_chunks);
+	free(sl);
+	_SL_COUNT(frees);
+}
+
+/*
+* public function that inserts data into a compact skip list. Upper levels 
+* are added as in _insert_node(); if the arena runs out while the tower is 
+* being built the tower is simply left shorter.
+*
+* Arguments:
+*	struct skip_list_compact *sl - pointer to compact skip list
+*	void *data - pointer to data to add
+* Returns:
+*	int - returns 1 if data was added, 0 if an equal element is already in
+*		the list and -1 if the arena is full or cannot grow
+*/
+
+int skip_list_compact_insert(struct skip_list_compact *sl, void *data) {
+	uint32_t prev = _compact_find_previous(sl, data);
+	uint32_t below;
+	uint32_t index;
+	uint32_t head;
+	struct _sl_cnode *prev_node = _cnode(sl, prev);
+
+	if(prev_node->_next_node && !_SL_GT(sl->_gt_func, _cnode(sl, prev_node->_next_node)->_data, data)) {
+		return 0;
+	}
+
+	index = _cnode_alloc(sl);
+	if(!index) {
+		return -1;
+	}
+	_compact_link(sl, index, prev, 0, data);
+	++(sl->_size);
+
+	while(_coin_flip(&(sl->_seed))) {
+		// walk back to the nearest node that reaches the next level
+		while(!(_cnode(sl, prev)->_prev_layer) && _cnode(sl, prev)->_prev_node) {
+			prev = _cnode(sl, prev)->_prev_node;
+		}
+
+		below = index;
+		index = _cnode_alloc(sl);
+		if(!index) {
+			break;
+		}
+
+		if(!(_cnode(sl, prev)->_prev_layer)) {
+			// prev is the header of the top sublist, put a new one on top
+			head = _cnode_alloc(sl);
+			if(!head) {
+				_cnode_free(sl, index);
+				break;
+			}
+			_cnode(sl, head)->_next_layer = sl->_first_node;
+			_cnode(sl, sl->_first_node)->_prev_layer = head;
+			sl->_first_node = head;
+		}
+
+		prev = _cnode(sl, prev)->_prev_layer;
+		_compact_link(sl, index, prev, below, data);
+	}
+
+	return 1;
+}
+
+/*
+* public function that removes data from a compact skip list.
+*
+* Arguments:
+*	struct skip_list_compact *sl - pointer to compact skip list
+*	void *data - pointer to data to remove
+* Returns:
+*	int - returns 0 if data was not in the list, 1 if it was removed
+*/
+
+int skip_list_compact_remove(struct skip_list_compact *sl, void *data) {
+	uint32_t index = _cnode(sl, _compact_find_previous(sl, data))->_next_node;
+	uint32_t up;
+	uint32_t below;
+	struct _sl_cnode *del_node;
+	struct _sl_cnode *head_node;
+
+	if(!index || _cnode(sl, index)->_data != data) {
+		return 0;
+	}
+
+	while(index) {
+		del_node = _cnode(sl, index);
+		up = del_node->_prev_layer;
+		_cnode(sl, del_node->_prev_node)->_next_node = del_node->_next_node;
+		if(del_node->_next_node) {
+			_cnode(sl, del_node->_next_node)->_prev_node = del_node->_prev_node;
+		}
+		_cnode_free(sl, index);
+		index = up;
+	}
+	--(sl->_size);
+
+	// lower the list while its top sublist is empty
+	head_node = _cnode(sl, sl->_first_node);
+	while(!(head_node->_next_node) && head_node->_next_layer) {
+		below = head_node->_next_layer;
+		_cnode_free(sl, sl->_first_node);
+		sl->_first_node = below;
+		head_node = _cnode(sl, below);
+		head_node->_prev_layer = 0;
+	}
+
+	return 1;
+}
+
+/*
+* public function that checks whether data is in a compact skip list.
+*
+* Arguments:
+*	struct skip_list_compact *sl - pointer to compact skip list
+*	void *data - pointer to data to look for
+* Returns:
+*	int - returns 1 if data is in the list, 0 otherwise
+*/
+
+int skip_list_compact_contains(struct skip_list_compact *sl, void *data) {
+	uint32_t index = _cnode(sl, _compact_find_previous(sl, data))->_next_node;
+
+	return index && _cnode(sl, index)->_data == data;
+}
+
+/*
+* public function that calls visit with every element of a compact skip list,
+* in order.
+*
+* Arguments:
+*	struct skip_list_compact *sl - pointer to compact skip list
+*	void (*visit)(void *, void *) - called with every element and ctx
+*	void *ctx - pointer passed through to visit
+* Returns:
+*	int - returns the number of elements visited
+*/
+
+int skip_list_compact_for_each(struct skip_list_compact *sl, void (*visit)(void *, void *), void *ctx) {
+	uint32_t index = sl->_first_node;
+	int count = 0;
+
+	while(_cnode(sl, index)->_next_layer) {
+		index = _cnode(sl, index)->_next_layer;
+	}
+	for(index = _cnode(sl, index)->_next_node; index; index = _cnode(sl, index)->_next_node) {
+		visit(_cnode(sl, index)->_data, ctx);
+		++count;
+	}
+
+	return count;
+}
+
+/*
+* public function that returns the number of elements in a compact skip list.
+*/
+
+int skip_list_compact_size(struct skip_list_compact *sl) {
+	return sl->_size;
+}
+
+/*
+* public function that fills in the structural statistics of a compact skip
+* list as skip_list_stats() does, without the sampled searches. total_bytes 
+* counts the whole arena, used or not, and page_mode the pages behind it.
+*
+* Arguments:
+*	struct skip_list_compact *sl - pointer to compact skip list
+*	struct skip_list_stats *stats - structure that receives the statistics
+* Returns:
+*	int - returns 0
+*/
+
+int skip_list_compact_stats(struct skip_list_compact *sl, struct skip_list_stats *stats) {
+	struct _sl_cnode *current_node;
+	uint32_t head;
+	uint32_t current;
+	uint32_t tower;
+	int level;
+	int height;
+
+	stats->levels = 0;
+	for(head = sl->_first_node; head; head = _cnode(sl, head)->_next_layer) {
+		++(stats->levels);
+	}
+	stats->size = 0;
+	stats->probes = 0;
+	stats->max_search_path = 0;
+	stats->avg_search_path = 0;
+	stats->avg_comparisons = 0;
+	stats->filter_queries = 0;
+	stats->filter_negatives = 0;
+	stats->filter_false_positives = 0;
+	stats->total_bytes = sizeof(struct skip_list_compact) + sl->_chunk_count * (sizeof(struct _sl_cnode *) + ((size_t)1 << sl->_shift) * sizeof(struct _sl_cnode));
+	stats->page_mode = sl->_page_mode;
+	for(level = 0; level < SKIP_LIST_STATS_LEVELS; ++level) {
+		stats->height_histogram[level] = 0;
+		stats->nodes_per_level[level] = 0;
+	}
+
+	head = sl->_first_node;
+	for(level = stats->levels - 1; head; --level) {
+		for(current = _cnode(sl, head)->_next_node; current; current = _cnode(sl, current)->_next_node) {
+			++(stats->nodes_per_level[level < SKIP_LIST_STATS_LEVELS ? level : SKIP_LIST_STATS_LEVELS - 1]);
+		}
+		if(!(_cnode(sl, head)->_next_layer)) {
+			break;
+		}
+		head = _cnode(sl, head)->_next_layer;
+	}
+
+	for(current = _cnode(sl, head)->_next_node; current; current = current_node->_next_node) {
+		current_node = _cnode(sl, current);
+		height = 0;
+		for(tower = current; tower; tower = _cnode(sl, tower)->_prev_layer) {
+			++height;
+		}
+		++(stats->height_histogram[height <= SKIP_LIST_STATS_LEVELS ? height - 1 : SKIP_LIST_STATS_LEVELS - 1]);
+		++(stats->size);
+	}
+
+	return 0;
+}
+
+/*public functions - concurrent relaxed priority queue*/
+
+/*
+* This private function draws a random number for the calling thread. The 
+* seed is per thread so concurrent sprays do not share the rand() state.
+*/
+static _Thread_local unsigned int _sl_spray_seed;
+
+int _spray_rand(void) {
+	if(!_sl_spray_seed) {
+		_sl_spray_seed = (unsigned int)time(NULL) ^ (unsigned int)(size_t)&_sl_spray_seed;
+	}
+
+	return rand_r(&_sl_spray_seed);
+}
+
+/*
+* This private function tries to take one copy of an l0 node by lowering its 
+* count. Returns the count the node had before, so 0 means nothing was taken
+* and 1 means the caller emptied the node.
+*/
+int _spray_claim(struct _sl_node *node) {
+	int count = __atomic_load_n(&(node->_count), __ATOMIC_RELAXED);
+
+	while(count > 0) {
+		if(__atomic_compare_exchange_n(&(node->_count), &count, count - 1, 0, 
+				__ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+			return count;
+		}
+	}
+
+	return 0;
+}
+
+/*
+* This private function unlinks the nodes emptied by claims. It must be called
+* with the exclusive lock held, so no claim is in flight and _claimed is 
+* exact; the walk stops as soon as all of them have been found.
+*/
+void _spray_cleanup(struct skip_list_spray *spray) {
+	struct _sl_node *current_node = spray->_sl->_base_node->_next_node;
+	struct _sl_node *next_node;
+	int claimed = spray->_claimed;
+
+	while(current_node && claimed) {
+		next_node = current_node->_next_node;
+		if(!(current_node->_count)) {
+			_remove_tower(spray->_sl, current_node);
+			--claimed;
+		}
+		current_node = next_node;
+	}
+
+	// poppers peek at the count without the lock once they are done
+	__atomic_store_n(&(spray->_claimed), 0, __ATOMIC_RELAXED);
+}
+
+/* 
+* public function that wraps a skip list in a relaxed concurrent priority 
+* queue for the given number of threads. The spray starts log2(threads) + 1 
+* levels up and moves up to as many nodes on each level on its way down, so 
+* a delete_min returns one of roughly the first threads * log2(threads)^2 
+* elements, and a single thread gets the exact minimum. The list must not be
+* used directly while the queue owns it.
+*
+* Arguments:
+*	struct skip_list *sl - pointer to skip list holding the queue
+*	int threads - number of threads expected to pop concurrently
+* Return:
+*	struct skip_list_spray * - pointer to a new queue, NULL if it could not
+*		be allocated; the list is left to the caller then
+*/
+
+struct skip_list_spray *skip_list_spray_create(struct skip_list *sl, int threads) {
+	struct skip_list_spray *spray = (struct skip_list_spray *)malloc(sizeof(struct skip_list_spray));
+	int log_threads = 0;
+
+	if(!spray) {
+		return NULL;
+	}
+	while((1 << (log_threads + 1)) <= threads) {
+		++log_threads;
+	}
+
+	spray->_sl = sl;
+	pthread_rwlock_init(&(spray->_lock), NULL);
+	spray->_height = threads > 1 ? log_threads + 1 : 0;
+	spray->_jump = threads > 1 ? log_threads + 1 : 0;
+	spray->_claimed = 0;
+	spray->_cleanup = 8 * (threads > 1 ? threads * (log_threads + 1) : 1);
+
+	return spray;
+}
+
+/* 
+* public function that frees the queue and hands the skip list back to the 
+* caller with every claimed element removed.
+*
+* Arguments:
+*	struct skip_list_spray *spray - pointer to queue
+* Return:
+*	struct skip_list * - pointer to the skip list the queue was built on
+*/
+
+struct skip_list *skip_list_spray_destroy(struct skip_list_spray *spray) {
+	struct skip_list *sl = spray->_sl;
+
+	_spray_cleanup(spray);
+	pthread_rwlock_destroy(&(spray->_lock));
+	free(spray);
+
+	return sl;
+}
+
+/* 
+* public function that inserts data into the queue. Inserts take the 
+* exclusive lock and first unlink any claimed nodes, so a claimed element can
+* be inserted again.
+*
+* Arguments:
+*	struct skip_list_spray *spray - pointer to queue
+*	void *data - pointer to data to insert
+* Returns:
+*	int - the result of skip_list_insert()
+*/
+
+int skip_list_spray_insert(struct skip_list_spray *spray, void *data) {
+	int result;
+
+	pthread_rwlock_wrlock(&(spray->_lock));
+	if(__atomic_load_n(&(spray->_claimed), __ATOMIC_RELAXED)) {
+		_spray_cleanup(spray);
+	}
+	result = skip_list_insert(spray->_sl, data);
+	pthread_rwlock_unlock(&(spray->_lock));
+
+	return result;
+}
+
+/* 
+* public function that removes one of the smallest elements of the queue. 
+* Many threads can run it at once.
+*
+* Arguments:
+*	struct skip_list_spray *spray - pointer to queue
+*	void **data - receives the element, left untouched if the queue is empty
+* Returns:
+*	int - returns 0 if the queue is empty, 1 otherwise
+*/
+
+int skip_list_spray_delete_min(struct skip_list_spray *spray, void **data) {
+	struct skip_list *sl = spray->_sl;
+	struct _sl_node *current_node;
+	int level;
+	int steps;
+	int claimed = 0;	// count of the node before the claim
+	int pending;
+
+	pthread_rwlock_rdlock(&(spray->_lock));
+
+	// start on the header of the spray height, or of the top sublist
+	current_node = sl->_first_node;
+	for(level = _count_levels(current_node) - 1; level > spray->_height; --level) {
+		current_node = current_node->_next_layer;
+	}
+
+	// walk a random distance on every level on the way down
+	for(;;) {
+		for(steps = spray->_jump ? _spray_rand() % (spray->_jump + 1) : 0; steps && current_node->_next_node; --steps) {
+			current_node = current_node->_next_node;
+		}
+		if(!(current_node->_next_layer)) {
+			break;
+		}
+		current_node = current_node->_next_layer;
+	}
+
+	// claim the landing node, or the first one after it that is not taken
+	if(!(current_node->_prev_node)) {
+		current_node = current_node->_next_node;
+	}
+	for(; current_node; current_node = current_node->_next_node) {
+		if((claimed = _spray_claim(current_node))) {
+			break;
+		}
+	}
+
+	// landed past the last free node, fall back to the front of l0
+	if(!claimed) {
+		for(current_node = sl->_base_node->_next_node; current_node; current_node = current_node->_next_node) {
+			if((claimed = _spray_claim(current_node))) {
+				break;
+			}
+		}
+	}
+
+	if(claimed) {
+		*data = current_node->_data;
+		__atomic_fetch_sub(&(sl->_size), 1, __ATOMIC_RELAXED);
+		if(claimed == 1) {
+			__atomic_fetch_add(&(spray->_claimed), 1, __ATOMIC_RELAXED);
+		}
+	}
+	pthread_rwlock_unlock(&(spray->_lock));
+
+	// unlink a batch of emptied nodes once enough have piled up, and wait
+	// for the lock if they pile up much further
+	pending = __atomic_load_n(&(spray->_claimed), __ATOMIC_RELAXED);
+	if(pending >= spray->_cleanup && (!pthread_rwlock_trywrlock(&(spray->_lock)) || 
+			(pending >= 4 * spray->_cleanup && !pthread_rwlock_wrlock(&(spray->_lock))))) {
+		_spray_cleanup(spray);
+		pthread_rwlock_unlock(&(spray->_lock));
+	}
+
+	return claimed > 0;
+}
+
+/*public functions - NUMA replicated upper levels*/
+
+#define _SL_MPOL_PREFERRED 1	// from <numaif.h>, which needs libnuma
+
+/*
+* This private function returns the NUMA node the calling thread runs on. 
+* Asking the kernel is a system call, so the answer is kept per thread and
+* refreshed every 4096 calls in case the thread has moved.
+*/
+static _Thread_local unsigned int _sl_numa_node;
+static _Thread_local unsigned int _sl_numa_calls;
+
+int _numa_node(void) {
+#ifdef SYS_getcpu
+	unsigned int cpu;
+
+	if(!(_sl_numa_calls++ & 4095)) {
+		if(syscall(SYS_getcpu, &cpu, &_sl_numa_node, NULL)) {
+			_sl_numa_node = 0;
+		}
+	}
+#endif
+
+	return (int)_sl_numa_node;
+}
+
+/*
+* This private function counts the NUMA nodes the system can have, from the
+* range list in /sys/devices/system/node/possible ("0-1", "0,2-3"). Returns 1
+* if it cannot tell.
+*/
+int _numa_nodes(void) {
+	FILE *possible = fopen("/sys/devices/system/node/possible", "r");
+	int node;
+	int nodes = 1;
+
+	if(!possible) {
+		return 1;
+	}
+	while(fscanf(possible, "%d", &node) == 1) {
+		if(node + 1 > nodes) {
+			nodes = node + 1;
+		}
+		if(fgetc(possible) == EOF) {
+			break;
+		}
+	}
+	fclose(possible);
+
+	return nodes;
+}
+
+/*
+* This private function copies the upper levels of a list for one NUMA node. 
+* The copy is mapped fresh and placed on the node by its memory policy where 
+* the kernel allows it, and by being first written from the node otherwise.
+* The lowest copied sublist is matched with the one below it by walking the
+* original and the copy side by side, so the original is only read and the 
+* caller needs nothing more than the shared lock.
+*
+* Arguments:
+*	struct skip_list_replicated *rep - pointer to replicated list
+*	int node - NUMA node the copy is for
+* Returns:
+*	struct _sl_replica * - the copy, NULL if there is nothing above the 
+*		shared levels or it could not be allocated
+*/
+struct _sl_replica *_replica_build(struct skip_list_replicated *rep, int node) {
+	struct _sl_node *heads[SKIP_LIST_STATS_LEVELS];
+	struct _sl_node *original;
+	struct _sl_node *below;		// original node under the one being copied
+	struct _sl_node *copy_below;	// its copy
+	struct _sl_node *copy;
+	struct _sl_node *copy_prev;
+	struct _sl_node *copy_head = NULL;
+	struct _sl_node *lower_head;
+	struct _sl_replica *replica;
+	size_t count = 0;
+	unsigned long mask;
+	char *arena;
+	int levels = 0;
+	int level;
+
+	for(original = rep->_sl->_first_node; original && levels < SKIP_LIST_STATS_LEVELS; original = original->_next_layer) {
+		heads[levels++] = original;
+	}
+	if(levels <= rep->_shared_levels || levels == SKIP_LIST_STATS_LEVELS) {
+		return NULL;
+	}
+
+	// heads[] runs from the top sublist down; copy heads[0..levels - shared - 1]
+	for(level = 0; level < levels - rep->_shared_levels; ++level) {
+		for(original = heads[level]; original; original = original->_next_node) {
+			++count;
+		}
+	}
+
+	replica = (struct _sl_replica *)malloc(sizeof(struct _sl_replica));
+	if(!replica) {
+		return NULL;
+	}
+	replica->_length = rep->_sl->_node_size * count;	// only levels above l0 are copied
+	arena = (char *)mmap(NULL, replica->_length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if(arena == MAP_FAILED) {
+		free(replica);
+		return NULL;
+	}
+#ifdef SYS_mbind
+	if(node < (int)(8 * sizeof(mask))) {
+		mask = 1ul << node;
+		syscall(SYS_mbind, arena, replica->_length, _SL_MPOL_PREFERRED, &mask, 8 * sizeof(mask) + 1, 0);
+	}
+#else
+	(void)mask;
+	(void)node;
+#endif
+
+	// copy from the lowest copied sublist up, so every node's copy below exists
+	lower_head = heads[levels - rep->_shared_levels];
+	for(level = levels - rep->_shared_levels - 1; level >= 0; --level) {
+		below = heads[level + 1];
+		copy_below = lower_head;
+		copy_prev = NULL;
+		for(original = heads[level]; original; original = original->_next_node) {
+			copy = (struct _sl_node *)arena;
+			arena += rep->_sl->_node_size;
+			memcpy(copy, original, rep->_sl->_node_size);
+
+			// the copy of original->_next_layer is as far along its
+			// sublist as the original is along the original sublist
+			while(below != original->_next_layer) {
+				below = below->_next_node;
+				copy_below = copy_below->_next_node;
+			}
+			copy->_next_layer = copy_below;
+			copy->_prev_layer = NULL;
+			copy->_prev_node = copy_prev;
+			copy->_next_node = NULL;
+			if(copy_prev) {
+				copy_prev->_next_node = copy;
+			} else {
+				copy_head = copy;
+			}
+			copy_prev = copy;
+		}
+		lower_head = copy_head;
+	}
+	replica->_first_node = copy_head;
+
+	return replica;
+}
+
+/*
+* This private function unmaps a copy made by _replica_build().
+*/
+void _replica_free(struct _sl_replica *replica) {
+	if(replica) {
+		munmap(replica->_first_node, replica->_length);
+		free(replica);
+	}
+}
+
+/*
+* This private function finds the node before data for a lookup on the 
+* calling thread's NUMA node. It starts from the node's copy of the upper 
+* levels when that copy is current. A stale copy is rebuilt once it has been
+* passed over by as many lookups as it has nodes, and no other thread is 
+* already doing so, which keeps the copying to at most one node per lookup 
+* however often the list is written; until then the lookup searches the 
+* shared list. Must be called with the shared lock held, which keeps _epoch
+* still.
+*
+* A copy is published before its epoch and only read after its epoch has
+* been found current, and a current copy is never replaced, so the copy a
+* rebuild replaces is one no lookup can be using.
+*/
+struct _sl_node *_replicated_search(struct skip_list_replicated *rep, void *data) {
+	struct skip_list *sl = rep->_sl;
+	struct _sl_replica *replica;
+	struct _sl_replica *stale;
+	int node = _numa_node() % rep->_nodes;
+	int idle = 0;
+
+	if(__atomic_load_n(&(rep->_replica_epochs[node]), __ATOMIC_ACQUIRE) != rep->_epoch) {
+		if(__atomic_add_fetch(&(rep->_stale_lookups[node]), 1, __ATOMIC_RELAXED) <= 
+				__atomic_load_n(&(rep->_rebuild_after[node]), __ATOMIC_RELAXED) ||
+				!__atomic_compare_exchange_n(&(rep->_building[node]), &idle, 1, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+			return _search(sl, data);
+		}
+		if(__atomic_load_n(&(rep->_replica_epochs[node]), __ATOMIC_ACQUIRE) != rep->_epoch) {
+			stale = rep->_replicas[node];
+			replica = _replica_build(rep, node);
+			__atomic_store_n(&(rep->_replicas[node]), replica, __ATOMIC_RELEASE);
+			__atomic_store_n(&(rep->_rebuild_after[node]), replica ? (long)(replica->_length / sl->_node_size) : 0, __ATOMIC_RELAXED);
+			__atomic_store_n(&(rep->_stale_lookups[node]), 0, __ATOMIC_RELAXED);
+			__atomic_store_n(&(rep->_replica_epochs[node]), rep->_epoch, __ATOMIC_RELEASE);
+			_replica_free(stale);
+		}
+		__atomic_store_n(&(rep->_building[node]), 0, __ATOMIC_RELEASE);
+	}
+
+	replica = __atomic_load_n(&(rep->_replicas[node]), __ATOMIC_ACQUIRE);
+	if(!replica) {
+		return _search(sl, data);
+	}
+	_SL_COUNT(replica_lookups);
+
+	if(sl->_bytes) {
+		return _find_previous_bytes(replica->_first_node, data);
+	}
+	return _find_previous(sl->_gt_func, replica->_first_node, data);
+}
+
+/* 
+* public function that wraps a skip list for read-mostly use across NUMA 
+* nodes. Every node gets a copy of the levels above the bottom shared_levels
+* the first time a thread on it looks something up, placed in the node's 
+* memory. Writes go through the wrapper and only mark the copies stale; each
+* node copies the list again once as many lookups as its copy has nodes have
+* used the shared levels instead, so the copies are only made again when 
+* lookups between writes outnumber the nodes above the shared levels. The 
+* list must not be used directly while the wrapper owns it.
+*
+* Arguments:
+*	struct skip_list *sl - pointer to skip list to share
+*	int nodes - number of NUMA nodes, 0 to ask the system
+*	int shared_levels - bottom levels left shared, at least 1
+* Return:
+*	struct skip_list_replicated * - pointer to a new wrapper, NULL if it 
+*		could not be allocated
+*/
+
+struct skip_list_replicated *skip_list_replicated_create(struct skip_list *sl, int nodes, int shared_levels) {
+	struct skip_list_replicated *rep = (struct skip_list_replicated *)malloc(sizeof(struct skip_list_replicated));
+
+	if(!rep) {
+		return NULL;
+	}
+	rep->_nodes = nodes > 0 ? nodes : _numa_nodes();
+	rep->_replicas = (struct _sl_replica **)calloc(rep->_nodes, sizeof(struct _sl_replica *));
+	rep->_replica_epochs = (long *)malloc(rep->_nodes * sizeof(long));
+	rep->_stale_lookups = (long *)calloc(rep->_nodes, sizeof(long));
+	rep->_rebuild_after = (long *)calloc(rep->_nodes, sizeof(long));
+	rep->_building = (int *)calloc(rep->_nodes, sizeof(int));
+	if(!(rep->_replicas) || !(rep->_replica_epochs) || !(rep->_stale_lookups) || !(rep->_rebuild_after) || !(rep->_building)) {
+		free(rep->_replicas);
+		free(rep->_replica_epochs);
+		free(rep->_stale_lookups);
+		free(rep->_rebuild_after);
+		free(rep->_building);
+		free(rep);
+		return NULL;
+	}
+
+	rep->_sl = sl;
+	pthread_rwlock_init(&(rep->_lock), NULL);
+	rep->_shared_levels = shared_levels > 1 ? shared_levels : 1;
+	rep->_epoch = 0;
+	for(int node = 0; node < rep->_nodes; ++node) {
+		rep->_replica_epochs[node] = -1;
+	}
+
+	return rep;
+}
+
+/* 
+* public function that frees the wrapper and its copies and hands the skip 
+* list back to the caller.
+*
+* Arguments:
+*	struct skip_list_replicated *rep - pointer to replicated list
+* Return:
+*	struct skip_list * - pointer to the skip list the wrapper was built on
+*/
+
+struct skip_list *skip_list_replicated_destroy(struct skip_list_replicated *rep) {
+	struct skip_list *sl = rep->_sl;
+
+	for(int node = 0; node < rep->_nodes; ++node) {
+		_replica_free(rep->_replicas[node]);
+	}
+	free(rep->_replicas);
+	free(rep->_replica_epochs);
+	free(rep->_stale_lookups);
+	free(rep->_rebuild_after);
+	free(rep->_building);
+	pthread_rwlock_destroy(&(rep->_lock));
+	free(rep);
+
+	return sl;
+}
+
+/* 
+* public function that inserts data into a replicated list, marking every 
+* copy stale.
+*
+* Arguments:
+*	struct skip_list_replicated *rep - pointer to replicated list
+*	void *data - pointer to data to insert
+* Returns:
+*	int - the result of skip_list_insert()
+*/
+
+int skip_list_replicated_insert(struct skip_list_replicated *rep, void *data) {
+	int result;
+
+	pthread_rwlock_wrlock(&(rep->_lock));
+	result = skip_list_insert(rep->_sl, data);
+	if(result > 0) {
+		++(rep->_epoch);
+	}
+	pthread_rwlock_unlock(&(rep->_lock));
+
+	return result;
+}
+
+/* 
+* public function that removes data from a replicated list, marking every 
+* copy stale.
+*
+* Arguments:
+*	struct skip_list_replicated *rep - pointer to replicated list
+*	void *data - pointer to data to remove
+* Returns:
+*	int - the result of skip_list_remove()
+*/
+
+int skip_list_replicated_remove(struct skip_list_replicated *rep, void *data) {
+	int result;
+
+	pthread_rwlock_wrlock(&(rep->_lock));
+	result = skip_list_remove(rep->_sl, data);
+	if(result) {
+		++(rep->_epoch);
+	}
+	pthread_rwlock_unlock(&(rep->_lock));
+
+	return result;
+}
+
+/* 
+* public function that checks whether a replicated list contains data, as 
+* skip_list_contains() does. Many threads can run it at once.
+*
+* Arguments:
+*	struct skip_list_replicated *rep - pointer to replicated list
+*	void *data - pointer to data to search for
+* Returns:
+*	int - returns 1 if data is in the list, 0 otherwise
+*/
+
+int skip_list_replicated_contains(struct skip_list_replicated *rep, void *data) {
+	int found;
+
+	pthread_rwlock_rdlock(&(rep->_lock));
+	found = _matches(rep->_sl, _replicated_search(rep, data)->_next_node, data);
+	pthread_rwlock_unlock(&(rep->_lock));
+
+	return found;
+}
+
+/*public functions - sharded skip lists*/
+
+/*
+* This private function finds the shard a key is routed to: the last one 
+* whose least key is not greater than it. Must be called with the table lock
+* held.
+*/
+struct _sl_shard *_shard_route(struct skip_list_sharded *ss, void *key) {
+	int lo = 0;
+	int hi = ss->_count - 1;
+	int mid;
+
+	while(lo < hi) {
+		mid = (lo + hi + 1) / 2;
+		if(_SL_GT(ss->_gt_func, ss->_shards[mid]->_lo, key)) {
+			hi = mid - 1;
+		} else {
+			lo = mid;
+		}
+	}
+
+	return ss->_shards[lo];
+}
+
+/*
+* This private function allocates a shard around a skip list.
+*/
+struct _sl_shard *_shard_create(struct skip_list *sl, void *lo) {
+	struct _sl_shard *shard = (struct _sl_shard *)malloc(sizeof(struct _sl_shard));
+
+	if(!shard) {
+		return NULL;
+	}
+	shard->_sl = sl;
+	shard->_lo = lo;
+	pthread_rwlock_init(&(shard->_lock), NULL);
+
+	return shard;
+}
+
+/*
+* This private function frees a shard, and its skip list unless it was handed
+* over to another shard.
+*/
+void _shard_destroy(struct _sl_shard *shard) {
+	if(shard->_sl) {
+		skip_list_destroy(shard->_sl);
+	}
+	pthread_rwlock_destroy(&(shard->_lock));
+	free(shard);
+}
+
+/*
+* This private function picks a key near the middle of a skip list without 
+* walking l0: the middle node of the highest sublist holding at least 16 
+* nodes. Returns NULL if the list has fewer than 2 elements.
+*/
+void *_shard_middle(struct skip_list *sl) {
+	struct _sl_node *head_node;
+	struct _sl_node *current_node;
+	int count = 0;
+
+	for(head_node = sl->_first_node; head_node; head_node = head_node->_next_layer) {
+		count = 0;
+		for(current_node = head_node->_next_node; current_node; current_node = current_node->_next_node) {
+			++count;
+		}
+		if(count >= 16 || !(head_node->_next_layer)) {
+			break;
+		}
+	}
+	if(count < 2) {
+		return NULL;
+	}
+
+	for(current_node = head_node->_next_node; count > 1; count -= 2) {
+		current_node = current_node->_next_node;
+	}
+
+	return current_node->_data;
+}
+
+/*
+* This private function splits the shards that grew too large and merges 
+* those that shrank too small, each into the neighbour before it, or after 
+* it for the first shard. Takes the table's exclusive lock, so no operation 
+* is inside any shard.
+*/
+void _sharded_rebalance(struct skip_list_sharded *ss) {
+	struct _sl_shard **shards;
+	struct _sl_shard *shard;
+	struct _sl_shard *upper;
+	struct skip_list *upper_list;
+	void *key;
+	int index;
+
+	pthread_rwlock_wrlock(&(ss->_lock));
+	for(index = 0; index < ss->_count; ++index) {
+		shard = ss->_shards[index];
+
+		if(skip_list_size(shard->_sl) > ss->_split_size && (key = _shard_middle(shard->_sl))) {
+			if(ss->_count == ss->_capacity) {
+				shards = (struct _sl_shard **)realloc(ss->_shards, 2 * ss->_capacity * sizeof(struct _sl_shard *));
+				if(!shards) {
+					break;
+				}
+				ss->_shards = shards;
+				ss->_capacity *= 2;
+			}
+			upper_list = skip_list_split(shard->_sl, key);
+			if(!upper_list) {
+				break;
+			}
+			upper = _shard_create(upper_list, key);
+			if(!upper) {
+				skip_list_concat(shard->_sl, upper_list);
+				skip_list_destroy(upper_list);
+				break;
+			}
+			skip_list_size(shard->_sl);	// refresh the sizes split left stale
+			skip_list_size(upper_list);
+			memmove(&(ss->_shards[index + 2]), &(ss->_shards[index + 1]), (ss->_count - index - 1) * sizeof(struct _sl_shard *));
+			ss->_shards[index + 1] = upper;
+			++(ss->_count);
+			--index;	// either half may still be too large
+		} else if(ss->_count > 1 && skip_list_size(shard->_sl) < ss->_merge_size) {
+			// pull the shard into the one before it, or the second into
+			// the first, unless the two together would need splitting
+			if(!index) {
+				shard = ss->_shards[1];
+				++index;
+			}
+			if(skip_list_size(ss->_shards[index - 1]->_sl) + skip_list_size(shard->_sl) > ss->_split_size) {
+				continue;
+			}
+			skip_list_concat(ss->_shards[index - 1]->_sl, shard->_sl);
+			_shard_destroy(shard);
+			memmove(&(ss->_shards[index]), &(ss->_shards[index + 1]), (ss->_count - index - 1) * sizeof(struct _sl_shard *));
+			--(ss->_count);
+			index -= 2;	// the merged shard may still be too small
+		}
+	}
+	pthread_rwlock_unlock(&(ss->_lock));
+}
+
+/* 
+* public function that initializes a new sharded skip list with a single 
+* shard. A shard is split once it holds more than split_size elements and
+* merged into a neighbour once it holds fewer than merge_size, which is kept
+* at or below split_size / 4 so the two never undo each other.
+*
+* Arguments:
+*	int (*gt_func)(void *, void *) - pointer to the greater than function
+*	int split_size - size above which a shard is split, at least 2
+*	int merge_size - size below which a shard is merged, 0 never merges
+* Return:
+*	struct skip_list_sharded * - pointer to a new sharded list, NULL if it
+*		could not be allocated
+*/
+
+struct skip_list_sharded *skip_list_sharded_create(int (*gt_func)(void *, void *), int split_size, int merge_size) {
+	struct skip_list_sharded *ss = (struct skip_list_sharded *)malloc(sizeof(struct skip_list_sharded));
+	struct skip_list *sl = skip_list_create(gt_func);
+
+	if(!ss || !sl) {
+		free(ss);
+		if(sl) {
+			skip_list_destroy(sl);
+		}
+		return NULL;
+	}
+	ss->_capacity = 8;
+	ss->_shards = (struct _sl_shard **)malloc(ss->_capacity * sizeof(struct _sl_shard *));
+	if(!(ss->_shards) || !(ss->_shards[0] = _shard_create(sl, NULL))) {
+		free(ss->_shards);
+		free(ss);
+		skip_list_destroy(sl);
+		return NULL;
+	}
+
+	ss->_gt_func = gt_func;
+	pthread_rwlock_init(&(ss->_lock), NULL);
+	ss->_count = 1;
+	ss->_split_size = split_size > 2 ? split_size : 2;
+	ss->_merge_size = merge_size < ss->_split_size / 4 ? merge_size : ss->_split_size / 4;
+
+	return ss;
+}
+
+/* 
+* public function that dealocates a sharded skip list and every shard.
+*
+* Arguments:
+*	struct skip_list_sharded *ss - pointer to sharded list
+*/
+
+void skip_list_sharded_destroy(struct skip_list_sharded *ss) {
+	for(int index = 0; index < ss->_count; ++index) {
+		_shard_destroy(ss->_shards[index]);
+	}
+	free(ss->_shards);
+	pthread_rwlock_destroy(&(ss->_lock));
+	free(ss);
+}
+
+/* 
+* public function that inserts data into the shard its key is routed to, 
+* holding only that shard's lock, and splits the shard afterwards if it grew
+* too large.
+*
+* Arguments:
+*	struct skip_list_sharded *ss - pointer to sharded list
+*	void *data - pointer to data to add
+* Returns:
+*	int - the result of skip_list_insert()
+*/
+
+int skip_list_sharded_insert(struct skip_list_sharded *ss, void *data) {
+	struct _sl_shard *shard;
+	int result;
+	int rebalance;
+
+	pthread_rwlock_rdlock(&(ss->_lock));
+	shard = _shard_route(ss, data);
+	pthread_rwlock_wrlock(&(shard->_lock));
+	result = skip_list_insert(shard->_sl, data);
+	rebalance = skip_list_size(shard->_sl) > ss->_split_size;
+	pthread_rwlock_unlock(&(shard->_lock));
+	pthread_rwlock_unlock(&(ss->_lock));
+
+	if(rebalance) {
+		_sharded_rebalance(ss);
+	}
+
+	return result;
+}
+
+/* 
+* public function that removes data from the shard its key is routed to, 
+* and merges the shard afterwards if it shrank too small.
+*
+* Arguments:
+*	struct skip_list_sharded *ss - pointer to sharded list
+*	void *data - pointer to data to remove
+* Returns:
+*	int - the result of skip_list_remove()
+*/
+
+int skip_list_sharded_remove(struct skip_list_sharded *ss, void *data) {
+	struct _sl_shard *shard;
+	int result;
+	int rebalance;
+
+	pthread_rwlock_rdlock(&(ss->_lock));
+	shard = _shard_route(ss, data);
+	pthread_rwlock_wrlock(&(shard->_lock));
+	result = skip_list_remove(shard->_sl, data);
+	rebalance = ss->_count > 1 && skip_list_size(shard->_sl) < ss->_merge_size;
+	pthread_rwlock_unlock(&(shard->_lock));
+	pthread_rwlock_unlock(&(ss->_lock));
+
+	if(rebalance) {
+		_sharded_rebalance(ss);
+	}
+
+	return result;
+}
+
+/* 
+* public function that checks whether a sharded skip list contains data.
+*
+* Arguments:
+*	struct skip_list_sharded *ss - pointer to sharded list
+*	void *data - pointer to data to search for
+* Returns:
+*	int - the result of skip_list_contains()
+*/
+
+int skip_list_sharded_contains(struct skip_list_sharded *ss, void *data) {
+	struct _sl_shard *shard;
+	int found;
+
+	pthread_rwlock_rdlock(&(ss->_lock));
+	shard = _shard_route(ss, data);
+	pthread_rwlock_rdlock(&(shard->_lock));
+	found = skip_list_contains(shard->_sl, data);
+	pthread_rwlock_unlock(&(shard->_lock));
+	pthread_rwlock_unlock(&(ss->_lock));
+
+	return found;
+}
+
+/* 
+* public function that finds the least element greater than key, searching 
+* on into the following shards when key's own shard has none. Called with 
+* the element it returned, it steps through the whole list in order, and 
+* stays correct while shards are split, merged or written to in between.
+*
+* Arguments:
+*	struct skip_list_sharded *ss - pointer to sharded list
+*	void *key - pointer to the data to step from, NULL for the first element
+*	void **data - receives the element, left untouched if there is none
+* Returns:
+*	int - returns 1 if an element was found, 0 otherwise
+*/
+
+int skip_list_sharded_next(struct skip_list_sharded *ss, void *key, void **data) {
+	struct _sl_shard *shard;
+	struct _sl_node *current_node;
+	int index = 0;
+	int found = 0;
+
+	pthread_rwlock_rdlock(&(ss->_lock));
+	if(key) {
+		shard = _shard_route(ss, key);
+		while(ss->_shards[index] != shard) {
+			++index;
+		}
+	}
+	for(; index < ss->_count && !found; ++index) {
+		shard = ss->_shards[index];
+		pthread_rwlock_rdlock(&(shard->_lock));
+		current_node = _base_head(shard->_sl->_first_node)->_next_node;
+		if(key) {
+			current_node = _search(shard->_sl, key)->_next_node;
+			while(current_node && !_SL_GT(ss->_gt_func, current_node->_data, key)) {
+				current_node = current_node->_next_node;
+			}
+		}
+		if(current_node) {
+			*data = current_node->_data;
+			found = 1;
+		}
+		pthread_rwlock_unlock(&(shard->_lock));
+	}
+	pthread_rwlock_unlock(&(ss->_lock));
+
+	return found;
+}
+
+/*
+* public function that calls visit with every element of a sharded skip list
+* not less than lo and less than hi, in order. Each shard is read under its 
+* own lock, so writers to the shards already visited or not yet reached go 
+* on meanwhile; splits and merges wait until the walk is done.
+*
+* Arguments:
+*	struct skip_list_sharded *ss - pointer to sharded list
+*	void *lo - pointer to the least data to visit, NULL for no lower bound
+*	void *hi - pointer to the data to stop at, NULL for no upper bound
+*	void (*visit)(void *, void *) - called with every element and ctx
+*	void *ctx - pointer passed through to visit
+* Returns:
+*	int - returns the number of elements visited
+*/
+
+int skip_list_sharded_for_each(struct skip_list_sharded *ss, void *lo, void *hi, void (*visit)(void *, void *), void *ctx) {
+	struct _sl_shard *shard;
+	struct _sl_node *current_node;
+	int index = 0;
+	int count = 0;
+	int done = 0;
+
+	pthread_rwlock_rdlock(&(ss->_lock));
+	if(lo) {
+		shard = _shard_route(ss, lo);
+		while(ss->_shards[index] != shard) {
+			++index;
+		}
+	}
+	for(; index < ss->_count && !done; ++index) {
+		shard = ss->_shards[index];
+		if(hi && index && !_SL_GT(ss->_gt_func, hi, shard->_lo)) {
+			break;
+		}
+		pthread_rwlock_rdlock(&(shard->_lock));
+		current_node = lo ? _search(shard->_sl, lo)->_next_node : _base_head(shard->_sl->_first_node)->_next_node;
+		for(; current_node; current_node = current_node->_next_node) {
+			if(hi && !_SL_GT(ss->_gt_func, hi, current_node->_data)) {
+				done = 1;
+				break;
+			}
+			visit(current_node->_data, ctx);
+			++count;
+		}
+		pthread_rwlock_unlock(&(shard->_lock));
+	}
+	pthread_rwlock_unlock(&(ss->_lock));
+
+	return count;
+}
+
+/*
+* public functions that return the number of elements and the number of 
+* shards of a sharded skip list.
+*/
+
+int skip_list_sharded_size(struct skip_list_sharded *ss) {
+	int size = 0;
+
+	pthread_rwlock_rdlock(&(ss->_lock));
+	for(int index = 0; index < ss->_count; ++index) {
+		pthread_rwlock_rdlock(&(ss->_shards[index]->_lock));
+		size += skip_list_size(ss->_shards[index]->_sl);
+		pthread_rwlock_unlock(&(ss->_shards[index]->_lock));
+	}
+	pthread_rwlock_unlock(&(ss->_lock));
+
+	return size;
+}
+
+int skip_list_sharded_shards(struct skip_list_sharded *ss) {
+	int count;
+
+	pthread_rwlock_rdlock(&(ss->_lock));
+	count = ss->_count;
+	pthread_rwlock_unlock(&(ss->_lock));
+
+	return count;
+}
+
+/* 
+* public functiion that prints out the list in rows and columns to improve 
+* readability when testing. The colums let you see the sublists more clearly. 
+*
+* Arguments:
+*	struct skip_list *sl - pointer to skip list
+*/
+
+void skip_list_print(struct skip_list *sl) {
+	//calculate pointer to L0 list
+	struct _sl_node *l0_list = sl->_first_node;
+	struct _sl_node *current_layer = sl->_first_node;
+	struct _sl_node *current_node = sl->_first_node;
+	struct _sl_node *l0_list_node = NULL;	
+
+	while(l0_list->_next_layer){
+		l0_list=l0_list->_next_layer;
+	}
+
+	l0_list_node=l0_list;
+	if(current_node->_next_node){// if current list is not empty	
+		while(current_node || current_layer->_next_layer){
+			if(current_node){
+				while(sl->_gt_func(current_node->_data, l0_list_node->_next_node->_data) && l0_list_node->_next_node){
+					printf("-\t-");
+					l0_list_node=l0_list_node->_next_node;				
+				}
+				printf("->%ld", (long)current_node->_data);
+				current_node=current_node->_next_node;
+			}
+			if(!(current_node)&&(current_layer->_next_layer)){
+				current_layer=current_layer->_next_layer;
+				current_node=current_layer;
+				l0_list_node=l0_list;
+				printf("\n");		
+			}
+		}
+		printf("\n");			
+		return;	
+	}
+}
+int fifo_gt(void *a, void *b) {return (long)a > (long)b;}
+
+/* 
+* Throughput benchmark of concurrent pop-min: every thread pops from a shared,
+* prefilled queue until it is drained, once through a mutex around 
+* skip_list_pop_min() and once through the spray queue.
+*/
+
+struct bench_args {
+	struct skip_list *sl;
+	struct skip_list_spray *spray;
+	pthread_mutex_t *mutex;
+	long pops;
+};
+
+void *bench_strict(void *arg) {
+	struct bench_args *args = (struct bench_args *)arg;
+	void *data;
+	int popped = 1;
+
+	while(popped) {
+		pthread_mutex_lock(args->mutex);
+		popped = skip_list_pop_min(args->sl, &data);
+		pthread_mutex_unlock(args->mutex);
+		args->pops += popped;
+	}
+
+	return NULL;
+}
+
+void *bench_spray(void *arg) {
+	struct bench_args *args = (struct bench_args *)arg;
+	void *data;
+
+	while(skip_list_spray_delete_min(args->spray, &data)) {
+		++(args->pops);
+	}
+
+	return NULL;
+}
+
+double bench_run(int threads, long elements, int spray) {
+	struct skip_list *sl = skip_list_create(fifo_gt);
+	struct skip_list_spray *queue = NULL;
+	pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+	pthread_t workers[64];
+	struct bench_args args[64];
+	struct timespec start, end;
+	int i;
+
+	for(long j = 0; j < elements; ++j) {
+		skip_list_insert(sl, (void *)(long)rand());
+	}
+	if(spray && !(queue = skip_list_spray_create(sl, threads))) {
+		skip_list_destroy(sl);
+		return 0;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for(i = 0; i < threads; ++i) {
+		args[i].sl = sl;
+		args[i].spray = queue;
+		args[i].mutex = &mutex;
+		args[i].pops = 0;
+		pthread_create(&workers[i], NULL, spray ? bench_spray : bench_strict, &args[i]);
+	}
+	for(i = 0; i < threads; ++i) {
+		pthread_join(workers[i], NULL);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	if(queue) {
+		skip_list_spray_destroy(queue);
+	}
+	skip_list_destroy(sl);
+
+	return elements / ((end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9) / 1e6;
+}
+
+void bench_pop_min(int max_threads) {
+	long elements = 1000000;
+
+	printf("threads\tstrict Mops/s\tspray Mops/s\n");
+	for(int threads = 1; threads <= max_threads && threads <= 64; threads *= 2) {
+		printf("%d\t%.2f\t\t%.2f\n", threads, 
+			bench_run(threads, elements, 0), bench_run(threads, elements, 1));
+	}
+}
+
+/* 
+* Lookup throughput of a read-mostly list shared by threads on every NUMA 
+* node, once searching the shared levels only and once starting from 
+* per-node replicas of the levels above l0. Run it under 
+*	numactl --cpunodebind=all --membind=0 ./skiplist numa [threads]
+* so the shared list sits on node 0 while the threads spread over all nodes,
+* and add perf stat -e node-loads,node-load-misses to count remote loads.
+*/
+
+struct numa_args {
+	struct skip_list_replicated *rep;
+	long elements;
+	long lookups;
+	long found;
+};
+
+void *bench_lookup(void *arg) {
+	struct numa_args *args = (struct numa_args *)arg;
+	unsigned int seed = (unsigned int)(size_t)arg;
+
+	for(long i = 0; i < args->lookups; ++i) {
+		args->found += skip_list_replicated_contains(args->rep, (void *)(2 * (long)(rand_r(&seed) % args->elements)));
+	}
+
+	return NULL;
+}
+
+double numa_run(int threads, long elements, int shared_levels) {
+	struct skip_list *sl = skip_list_create(fifo_gt);
+	struct skip_list_replicated *rep;
+	pthread_t workers[64];
+	struct numa_args args[64];
+	struct timespec start, end;
+	long lookups = 250000;
+	int i;
+
+	for(long j = 0; j < elements; ++j) {
+		skip_list_insert(sl, (void *)(2 * j));
+	}
+	rep = skip_list_replicated_create(sl, 0, shared_levels);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for(i = 0; i < threads; ++i) {
+		args[i].rep = rep;
+		args[i].elements = elements;
+		args[i].lookups = lookups;
+		args[i].found = 0;
+		pthread_create(&workers[i], NULL, bench_lookup, &args[i]);
+	}
+	for(i = 0; i < threads; ++i) {
+		pthread_join(workers[i], NULL);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	skip_list_replicated_destroy(rep);
+	skip_list_destroy(sl);
+
+	return threads * lookups / ((end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9) / 1e6;
+}
+
+void bench_numa(int max_threads) {
+	long elements = 4000000;
+
+	printf("NUMA nodes: %d\n", _numa_nodes());
+	printf("threads\tshared Mops/s\treplicated Mops/s\n");
+	for(int threads = 1; threads <= max_threads && threads <= 64; threads *= 2) {
+		printf("%d\t%.2f\t\t%.2f\n", threads, 
+			numa_run(threads, elements, INT_MAX), numa_run(threads, elements, 1));
+	}
+}
+
+/*
+* Randomized checks, run by ./skiplist check [rounds] [seed]. Each one drives a
+* feature with random operations, compares every answer with a brute-force
+* model kept in plain arrays, and walks every level of the lists involved with
+* check_links() after each step. They print the first mismatch they find and
+* return 1 then, 0 if everything agreed.
+*/
+
+/*
+* Checks the links of every level of a list: both directions of every link,
+* the order of the nodes, the towers standing on l0, both ends, and the size
+* unless it is stale.
+*/
+int check_links(struct skip_list *sl, const char *what) {
+	struct _sl_node *head_node;
+	struct _sl_node *current_node;
+	struct _sl_node *last_node = NULL;
+	long size = 0;
+
+	if(sl->_first_node->_prev_layer || _base_head(sl->_first_node) != sl->_base_node) {
+		printf("%s: headers broken\n", what);
+		return 1;
+	}
+
+	for(head_node = sl->_first_node; head_node; head_node = head_node->_next_layer) {
+		if(head_node->_prev_node || (head_node->_next_layer && head_node->_next_layer->_prev_layer != head_node)) {
+			printf("%s: header links broken\n", what);
+			return 1;
+		}
+		for(current_node = head_node->_next_node; current_node; current_node = current_node->_next_node) {
+			if(current_node->_prev_node->_next_node != current_node) {
+				printf("%s: prev link broken\n", what);
+				return 1;
+			}
+			if(current_node->_next_node && sl->_gt_func && (_SL_GT(sl->_gt_func, current_node->_data, current_node->_next_node->_data) ||
+					(sl->_multiset && !_SL_GT(sl->_gt_func, current_node->_next_node->_data, current_node->_data)))) {
+				printf("%s: out of order\n", what);
+				return 1;
+			}
+			if(head_node->_next_layer && (!(current_node->_next_layer) ||
+					current_node->_next_layer->_prev_layer != current_node ||
+					current_node->_next_layer->_data != current_node->_data)) {
+				printf("%s: tower broken\n", what);
+				return 1;
+			}
+			if(!(head_node->_next_layer)) {
+				size += current_node->_count;
+				last_node = current_node;
+			}
+			if(sl->_bytes && (current_node->_key._prefix != _bytes_prefix((struct skip_list_bytes *)current_node->_data) ||
+					current_node->_key_length != ((struct skip_list_bytes *)current_node->_data)->length)) {
+				printf("%s: inline key wrong\n", what);
+				return 1;
+			}
+		}
+	}
+
+	if(last_node != sl->_last_node || (!(sl->_size_stale) && size != sl->_size)) {
+		printf("%s: ends or size wrong\n", what);
+		return 1;
+	}
+
+	// every aggregate must match the one recomputed from the level below
+	for(head_node = sl->_aggregate ? sl->_base_node : NULL; head_node; head_node = head_node->_prev_layer) {
+		for(current_node = head_node; current_node; current_node = current_node->_next_node) {
+			double aggregate = current_node->_key._agg;
+
+			_recompute_aggregate(sl, current_node);
+			if(aggregate != current_node->_key._agg) {
+				printf("%s: stale aggregate\n", what);
+				return 1;
+			}
+		}
+	}
+
+	return 0;
+}
+
+/*
+* Multi-version lists: random puts, deletes, snapshots, releases and
+* collections, with a copy of the model taken for every open snapshot. Every
+* key is read at every open snapshot, and one of them is scanned in order.
+*/
+int check_mvcc(unsigned int *seed, int rounds) {
+	enum {KEYS = 64, OPEN = 8};
+	struct skip_list *sl = skip_list_create_mvcc(fifo_gt);
+	struct skip_list *other = skip_list_create_mvcc(fifo_gt);
+	struct skip_list_snapshot *snapshots[OPEN] = {NULL};
+	long models[OPEN + 1][KEYS + 1] = {{0}};	// value of every key, 0 if unset; the last one is the latest
+	long *latest = models[OPEN];
+	unsigned long long last_sequence = 0;
+	unsigned long long sequence;
+	void *key;
+	void *value;
+	long k;
+	int slot;
+	int failed = 0;
+
+	for(int round = 0; round < rounds && !failed; ++round) {
+		k = 1 + rand_r(seed) % KEYS;
+		slot = rand_r(seed) % OPEN;
+		switch(rand_r(seed) % 8) {
+		case 0: case 1: case 2:
+			sequence = skip_list_mvcc_put(sl, (void *)k, (void *)(long)(round + 1));
+			failed |= sequence <= last_sequence;
+			last_sequence = sequence;
+			latest[k] = round + 1;
+			break;
+		case 3: case 4:
+			sequence = skip_list_mvcc_delete(sl, (void *)k);
+			if(latest[k]) {
+				failed |= sequence <= last_sequence;
+				last_sequence = sequence;
+			} else {
+				failed |= sequence != 0;
+			}
+			latest[k] = 0;
+			break;
+		case 5:
+			if(!snapshots[slot]) {
+				snapshots[slot] = skip_list_snapshot(sl);
+				memcpy(models[slot], latest, sizeof(models[slot]));
+			}
+			break;
+		case 6:
+			if(snapshots[slot]) {
+				skip_list_snapshot_release(sl, snapshots[slot]);
+				snapshots[slot] = NULL;
+			}
+			break;
+		default:
+			skip_list_mvcc_collect(sl);
+		}
+		if(failed) {
+			printf("mvcc: wrong sequence number in round %d\n", round);
+			break;
+		}
+
+		for(slot = 0; slot <= OPEN && !failed; ++slot) {
+			if(slot < OPEN && !snapshots[slot]) {
+				continue;
+			}
+			for(k = 1; k <= KEYS && !failed; ++k) {
+				value = NULL;
+				if(skip_list_mvcc_get(sl, (void *)k, slot < OPEN ? snapshots[slot] : NULL, &value) != !!models[slot][k] ||
+						(long)value != models[slot][k]) {
+					printf("mvcc: key %ld read wrong at snapshot %d in round %d\n", k, slot, round);
+					failed = 1;
+				}
+			}
+		}
+
+		// scan one view in order, the latest if its snapshot is not open
+		slot = rand_r(seed) % (OPEN + 1);
+		if(slot < OPEN && !snapshots[slot]) {
+			slot = OPEN;
+		}
+		key = NULL;
+		for(k = 1; k <= KEYS + 1 && !failed; ++k) {
+			if(k <= KEYS && !models[slot][k]) {
+				continue;
+			}
+			if(skip_list_mvcc_next(sl, slot < OPEN ? snapshots[slot] : NULL, key, &key, &value) != (k <= KEYS) ||
+					(k <= KEYS && ((long)key != k || (long)value != models[slot][k]))) {
+				printf("mvcc: scan at snapshot %d wrong at key %ld in round %d\n", slot, k, round);
+				failed = 1;
+			}
+		}
+		failed |= check_links(sl, "mvcc");
+	}
+
+	// a merge cannot combine the version chains of a key in both lists
+	skip_list_mvcc_put(other, (void *)1, (void *)1);
+	if(!failed && skip_list_merge(sl, other) != -1) {
+		printf("mvcc: merge not refused\n");
+		failed = 1;
+	}
+
+	for(slot = 0; slot < OPEN; ++slot) {
+		if(snapshots[slot]) {
+			skip_list_snapshot_release(sl, snapshots[slot]);
+		}
+	}
+	skip_list_destroy(sl);
+	skip_list_destroy(other);
+
+	return failed;
+}
+
+double check_sum(double a, double b) {return a + b;}
+double check_value(void *data) {return (double)(long)data;}
+
+/*
+* Augmented lists summing their keys, in both modes: random inserts, removes,
+* range removals, pops, and splits joined again right away, after which sums
+* over random ranges are compared with the model.
+*/
+int check_aggregate(unsigned int *seed, int rounds) {
+	enum {KEYS = 200};
+	struct skip_list_monoid sum = {0, check_sum, check_value};
+	int model[KEYS + 2];
+	struct skip_list *sl;
+	struct skip_list *upper;
+	void *data;
+	double expected;
+	long k;
+	long hi;
+	int failed = 0;
+
+	for(int mode = 0; mode < 2 && !failed; ++mode) {
+		memset(model, 0, sizeof(model));
+		sl = mode ? skip_list_create_multiset(fifo_gt) : skip_list_create(fifo_gt);
+
+		// the multiset is augmented once it holds keys, moving its upper nodes
+		for(k = 1; mode && k <= KEYS; k += 3) {
+			skip_list_insert(sl, (void *)k);
+			model[k] = 1;
+		}
+		failed |= skip_list_set_aggregate(sl, &sum) != 0 || check_links(sl, "aggregate set");
+
+		for(int round = 0; round < rounds / 2 && !failed; ++round) {
+			k = 1 + rand_r(seed) % KEYS;
+			hi = k + rand_r(seed) % 20;
+			switch(rand_r(seed) % 10) {
+			case 0: case 1: case 2: case 3:
+				skip_list_insert(sl, (void *)k);
+				model[k] = mode ? model[k] + 1 : 1;
+				break;
+			case 4: case 5:
+				skip_list_remove(sl, (void *)k);
+				model[k] -= !!model[k];
+				break;
+			case 6:
+				skip_list_remove_range(sl, (void *)k, (void *)hi);
+				for(; k < hi && k <= KEYS; ++k) {
+					model[k] = 0;
+				}
+				break;
+			case 7:
+				for(k = 1; k <= KEYS && !model[k]; ++k);
+				if(skip_list_pop_min(sl, &data) != (k <= KEYS) || (k <= KEYS && (long)data != k)) {
+					failed = 1;
+				}
+				model[k] -= k <= KEYS;
+				break;
+			case 8:
+				for(k = KEYS; k >= 1 && !model[k]; --k);
+				if(skip_list_pop_max(sl, &data) != (k >= 1) || (k >= 1 && (long)data != k)) {
+					failed = 1;
+				}
+				model[k] -= k >= 1;
+				break;
+			default:
+				upper = skip_list_split(sl, (void *)k);
+				failed |= check_links(sl, "aggregate lower") || check_links(upper, "aggregate upper");
+				skip_list_concat(sl, upper);
+				skip_list_destroy(upper);
+			}
+			if(failed) {
+				printf("aggregate: operation failed in mode %d round %d\n", mode, round);
+				break;
+			}
+
+			k = 1 + rand_r(seed) % (KEYS + 1);
+			hi = k + rand_r(seed) % (KEYS + 2 - k);
+			expected = 0;
+			for(long key = k; key < hi; ++key) {
+				expected += (double)key * model[key];
+			}
+			if(skip_list_aggregate(sl, (void *)k, (void *)hi) != expected) {
+				printf("aggregate: sum over [%ld, %ld) wrong in mode %d round %d\n", k, hi, mode, round);
+				failed = 1;
+			}
+			failed |= check_links(sl, "aggregate");
+		}
+
+		skip_list_destroy(sl);
+	}
+
+	return failed;
+}
+
+void check_report(void *item, void *ctx) {
+	++(((int *)ctx)[(long)item]);
+}
+
+/*
+* Interval lists: random intervals are added and removed, and every point and
+* a random range are queried. Each interval the model says contains the 
+* point, or overlaps the range, must be reported exactly once, and no other.
+*/
+int check_intervals(unsigned int *seed, int rounds) {
+	enum {KEYS = 64, SLOTS = 48};
+	struct skip_list *sl = skip_list_create_interval(fifo_gt);
+	struct skip_list *other = skip_list_create_interval(fifo_gt);
+	struct skip_list_interval *handles[SLOTS] = {NULL};
+	long lo[SLOTS];
+	long hi[SLOTS];
+	int reports[SLOTS];
+	int expected;
+	long from;
+	long to;
+	int slot;
+	int count;
+	int failed = 0;
+
+	for(int round = 0; round < rounds / 4 && !failed; ++round) {
+		slot = rand_r(seed) % SLOTS;
+		if(handles[slot]) {
+			failed |= skip_list_interval_remove(sl, handles[slot]) != 1;
+			handles[slot] = NULL;
+		} else {
+			lo[slot] = 1 + rand_r(seed) % KEYS;
+			hi[slot] = lo[slot] + rand_r(seed) % (rand_r(seed) % 2 ? 4 : KEYS);
+			handles[slot] = skip_list_interval_insert(sl, (void *)lo[slot], (void *)hi[slot], (void *)(long)slot);
+			failed |= !handles[slot];
+		}
+		if(failed || check_links(sl, "intervals")) {
+			printf("intervals: update failed in round %d\n", round);
+			failed = 1;
+			break;
+		}
+
+		// stab every point, then overlap one random range
+		for(int query = 0; query <= KEYS + 2 && !failed; ++query) {
+			from = to = query;
+			if(query == KEYS + 2) {
+				from = 1 + rand_r(seed) % KEYS;
+				to = from + rand_r(seed) % KEYS;
+			}
+			memset(reports, 0, sizeof(reports));
+			count = from == to ? skip_list_stab(sl, (void *)from, check_report, reports) :
+				skip_list_overlap(sl, (void *)from, (void *)to, check_report, reports);
+			for(slot = 0; slot < SLOTS; ++slot) {
+				expected = handles[slot] && lo[slot] <= to && from <= hi[slot];
+				count -= expected;
+				if(reports[slot] != expected) {
+					printf("intervals: [%ld, %ld] reported %d times for [%ld, %ld] in round %d\n",
+						lo[slot], hi[slot], reports[slot], from, to, round);
+					failed = 1;
+				}
+			}
+			if(count && !failed) {
+				printf("intervals: wrong count for [%ld, %ld] in round %d\n", from, to, round);
+				failed = 1;
+			}
+		}
+	}
+
+	// merging would move the links under the markers
+	skip_list_interval_insert(other, (void *)1, (void *)2, NULL);
+	if(!failed && skip_list_merge(sl, other) != -1) {
+		printf("intervals: merge not refused\n");
+		failed = 1;
+	}
+
+	skip_list_destroy(sl);
+	skip_list_destroy(other);
+
+	return failed;
+}
+
+/*
+* Byte string lists, with short keys over a three letter alphabet that 
+* includes the zero byte, so that keys often share their inline prefix or are
+* prefixes of each other. The keys are distinct, as equal keys would only be
+* told apart by pointer. Every lookup is repeated by key with 
+* skip_list_count(), on a copy of the key, and the order of l0 is checked 
+* against memcmp().
+*/
+int check_bytes(unsigned int *seed, int rounds) {
+	enum {KEYS = 300, LENGTH = 16};
+	static unsigned char names[KEYS][LENGTH];
+	struct skip_list_bytes keys[KEYS];
+	int model[KEYS];
+	struct skip_list *sl = skip_list_create_bytes();
+	struct _sl_node *current_node;
+	unsigned char copy[LENGTH];
+	struct skip_list_bytes key;
+	int k;
+	int failed = 0;
+
+	for(k = 0; k < KEYS; ++k) {
+		keys[k].length = rand_r(seed) % (LENGTH + 1);
+		for(size_t i = 0; i < keys[k].length; ++i) {
+			names[k][i] = "ab"[rand_r(seed) % 3];	// 'a', 'b' or the terminating zero
+		}
+		keys[k].bytes = names[k];
+		model[k] = 0;
+		for(int other = 0; other < k; ++other) {
+			if(keys[other].length == keys[k].length && !memcmp(names[other], names[k], keys[k].length)) {
+				--k;	// draw it again
+				break;
+			}
+		}
+	}
+
+	for(int round = 0; round < rounds && !failed; ++round) {
+		k = rand_r(seed) % KEYS;
+		if(rand_r(seed) % 3) {
+			failed |= skip_list_insert(sl, &keys[k]) != !model[k];
+			model[k] = 1;
+		} else {
+			failed |= skip_list_remove(sl, &keys[k]) != model[k];
+			model[k] = 0;
+		}
+		if(failed || check_links(sl, "bytes")) {
+			printf("bytes: update failed in round %d\n", round);
+			failed = 1;
+			break;
+		}
+
+		// look one key up by pointer and by a copy of it
+		k = rand_r(seed) % KEYS;
+		memcpy(copy, names[k], keys[k].length);
+		key.bytes = copy;
+		key.length = keys[k].length;
+		if(skip_list_contains(sl, &keys[k]) != model[k] || skip_list_count(sl, &key) != model[k]) {
+			printf("bytes: key %d found wrong in round %d\n", k, round);
+			failed = 1;
+		}
+
+		for(current_node = sl->_base_node->_next_node; current_node && current_node->_next_node && !failed; current_node = current_node->_next_node) {
+			struct skip_list_bytes *a = (struct skip_list_bytes *)current_node->_data;
+			struct skip_list_bytes *b = (struct skip_list_bytes *)current_node->_next_node->_data;
+			int order = memcmp(a->bytes, b->bytes, a->length < b->length ? a->length : b->length);
+
+			if(order > 0 || (!order && a->length >= b->length)) {
+				printf("bytes: l0 out of memcmp() order in round %d\n", round);
+				failed = 1;
+			}
+		}
+	}
+
+	skip_list_destroy(sl);
+
+	return failed;
+}
+
+/*
+* Intrusive lists, against a model of which elements are in: random inserts
+* and removes of elements whose hooks sit behind a key, lookups by a probe 
+* element that is never in the list, and walks with next and prev in both 
+* directions. Every level must be a sorted subsequence of l0 made of hooks 
+* tall enough for it, so the towers above SKIP_LIST_HOOK_INLINE are covered.
+*/
+
+struct check_item {
+	long key;
+	struct skip_list_hook hook;
+};
+
+int check_item_gt(void *a, void *b) {
+	return ((struct check_item *)a)->key > ((struct check_item *)b)->key;
+}
+
+int check_intrusive(unsigned int *seed, int rounds) {
+	enum {KEYS = 512};
+	static struct check_item items[KEYS];
+	int model[KEYS] = {0};
+	struct skip_list_intrusive *sl = skip_list_intrusive_create(check_item_gt, offsetof(struct check_item, hook));
+	struct skip_list_hook *hook;
+	struct check_item probe;
+	struct check_item *item;
+	int k;
+	int size = 0;
+	int failed = 0;
+
+	for(k = 0; k < KEYS; ++k) {
+		items[k].key = k;
+	}
+
+	for(int round = 0; round < rounds && !failed; ++round) {
+		k = rand_r(seed) % KEYS;
+		if(rand_r(seed) % 3) {
+			failed |= skip_list_intrusive_insert(sl, &items[k]) != !model[k];
+			size += !model[k];
+			model[k] = 1;
+		} else {
+			failed |= skip_list_intrusive_remove(sl, &items[k]) != model[k];
+			size -= model[k];
+			model[k] = 0;
+		}
+		if(failed || skip_list_intrusive_size(sl) != size) {
+			printf("intrusive: update failed in round %d\n", round);
+			failed = 1;
+			break;
+		}
+
+		k = rand_r(seed) % KEYS;
+		probe.key = k;
+		if(skip_list_intrusive_find(sl, &probe) != (model[k] ? &items[k] : NULL)) {
+			printf("intrusive: key %d found wrong in round %d\n", k, round);
+			failed = 1;
+		}
+
+		// walk l0 both ways against the model
+		item = (struct check_item *)skip_list_intrusive_first(sl);
+		for(k = 0; k < KEYS && !failed; ++k) {
+			if(!model[k]) {
+				continue;
+			}
+			if(item != &items[k]) {
+				printf("intrusive: next skipped key %d in round %d\n", k, round);
+				failed = 1;
+			}
+			item = (struct check_item *)skip_list_intrusive_next(sl, item);
+		}
+		failed |= item != NULL;
+		item = (struct check_item *)skip_list_intrusive_last(sl);
+		for(k = KEYS - 1; k >= 0 && !failed; --k) {
+			if(!model[k]) {
+				continue;
+			}
+			if(item != &items[k]) {
+				printf("intrusive: prev skipped key %d in round %d\n", k, round);
+				failed = 1;
+			}
+			item = (struct check_item *)skip_list_intrusive_prev(sl, item);
+		}
+		failed |= item != NULL;
+
+		// every level is sorted and made of hooks that reach it
+		for(int level = 0; level < sl->_levels && !failed; ++level) {
+			long previous = -1;
+
+			for(hook = sl->_head[level]; hook; hook = *_hook_link(sl, hook, level)) {
+				item = (struct check_item *)_hook_item(sl, hook);
+				if(item->key <= previous || !model[item->key] || hook->_height <= level) {
+					printf("intrusive: level %d broken in round %d\n", level, round);
+					failed = 1;
+					break;
+				}
+				previous = item->key;
+			}
+		}
+		if(!failed && size && !(sl->_head[sl->_levels - 1])) {
+			printf("intrusive: empty top level in round %d\n", round);
+			failed = 1;
+		}
+	}
+
+	skip_list_intrusive_destroy(sl);
+
+	return failed;
+}
+
+/*
+* This function checks the links of a compact list against the model of the
+* keys in it: every sublist sorted with matching back links, every upper node
+* on top of a node with the same data, l0 holding exactly the model, and every
+* index of the arena either linked or on the free chain.
+*/
+int check_compact_links(struct skip_list_compact *sl, int *model, int keys, const char *what) {
+	uint32_t head;
+	uint32_t index;
+	uint32_t linked = 0;
+	struct _sl_cnode *current_node;
+	int size = 0;
+
+	for(head = sl->_first_node; head; head = _cnode(sl, head)->_next_layer) {
+		++linked;
+		for(index = head; (current_node = _cnode(sl, index))->_next_node; index = current_node->_next_node) {
+			struct _sl_cnode *next_node = _cnode(sl, current_node->_next_node);
+
+			++linked;
+			if(next_node->_prev_node != index || (index != head && (long)next_node->_data <= (long)current_node->_data) ||
+					(next_node->_next_layer && (_cnode(sl, next_node->_next_layer)->_data != next_node->_data ||
+					_cnode(sl, next_node->_next_layer)->_prev_layer != current_node->_next_node)) ||
+					(!!next_node->_next_layer != !!_cnode(sl, head)->_next_layer)) {
+				printf("%s: sublist broken\n", what);
+				return 1;
+			}
+			if(!(_cnode(sl, head)->_next_layer)) {
+				if((long)next_node->_data >= keys || !model[(long)next_node->_data]) {
+					printf("%s: key %ld is not in the model\n", what, (long)next_node->_data);
+					return 1;
+				}
+				++size;
+			}
+		}
+		if(head != sl->_first_node && _cnode(sl, head)->_prev_layer == 0) {
+			printf("%s: header not linked up\n", what);
+			return 1;
+		}
+	}
+	for(index = sl->_free; index; index = _cnode(sl, index)->_next_node) {
+		++linked;
+	}
+
+	if(skip_list_compact_size(sl) != size) {
+		printf("%s: size %d with %d elements on l0\n", what, skip_list_compact_size(sl), size);
+		return 1;
+	}
+	for(int k = 0; k < keys; ++k) {
+		size -= model[k];
+	}
+	if(size) {
+		printf("%s: l0 does not hold the model\n", what);
+		return 1;
+	}
+	if(linked != sl->_used) {
+		printf("%s: %u nodes linked or free out of %u\n", what, linked, sl->_used);
+		return 1;
+	}
+	if(_cnode(sl, sl->_first_node)->_next_layer && !(_cnode(sl, sl->_first_node)->_next_node)) {
+		printf("%s: empty top sublist\n", what);
+		return 1;
+	}
+
+	return 0;
+}
+
+/*
+* Compact lists, on chunks of 8 nodes so the arena grows through many of 
+* them, against a model of the keys in the list. Then new lists with their 
+* arenas capped at 8 to 71 nodes are filled until an insert fails, which must
+* leave the list as it was; removing one key must make room again.
+*/
+int check_compact(unsigned int *seed, int rounds) {
+	enum {KEYS = 512};
+	int model[KEYS] = {0};
+	struct skip_list_compact *sl = _compact_create(fifo_gt, SKIP_LIST_PAGES_DEFAULT, 3);
+	long k;
+	int size = 0;
+	int added;
+	int failed = 0;
+
+	for(int round = 0; round < rounds && !failed; ++round) {
+		k = rand_r(seed) % KEYS;
+		if(rand_r(seed) % 3) {
+			failed |= skip_list_compact_insert(sl, (void *)k) != !model[k];
+			size += !model[k];
+			model[k] = 1;
+		} else {
+			failed |= skip_list_compact_remove(sl, (void *)k) != model[k];
+			size -= model[k];
+			model[k] = 0;
+		}
+		k = rand_r(seed) % KEYS;
+		if(failed || skip_list_compact_size(sl) != size || skip_list_compact_contains(sl, (void *)k) != model[k]) {
+			printf("compact: key %ld wrong in round %d\n", k, round);
+			failed = 1;
+			break;
+		}
+		failed |= check_compact_links(sl, model, KEYS, "compact");
+	}
+
+	// fill capped arenas until they are full, so inserts fail on l0, on a
+	// tower and on a new header
+	skip_list_compact_destroy(sl);
+	sl = NULL;
+	for(uint32_t limit = 8; limit < 72 && !failed; ++limit) {
+		if(sl) {
+			skip_list_compact_destroy(sl);
+		}
+		sl = _compact_create(fifo_gt, SKIP_LIST_PAGES_DEFAULT, 3);
+		sl->_limit = limit;
+		size = 0;
+		for(k = 0; k < KEYS; ++k) {
+			model[k] = 0;
+		}
+
+		for(added = 1; added == 1 && !failed; ) {
+			do {
+				k = rand_r(seed) % KEYS;
+			} while(model[k]);
+			added = skip_list_compact_insert(sl, (void *)k);
+			if(added == 1) {
+				model[k] = 1;
+				++size;
+			} else if(added != -1 || skip_list_compact_contains(sl, (void *)k)) {
+				printf("compact: a full arena took key %ld\n", k);
+				failed = 1;
+			}
+			failed |= skip_list_compact_size(sl) != size || check_compact_links(sl, model, KEYS, "compact limit");
+		}
+
+		if(!failed) {
+			// any removed key frees its l0 node for the key that did not fit
+			long removed;
+
+			for(removed = 0; !model[removed]; ++removed);
+			skip_list_compact_remove(sl, (void *)removed);
+			model[removed] = 0;
+			failed |= skip_list_compact_insert(sl, (void *)k) != 1;
+			model[k] = 1;
+			failed |= check_compact_links(sl, model, KEYS, "compact reuse");
+		}
+	}
+
+	skip_list_compact_destroy(sl);
+
+	return failed;
+}
+
+/*
+* Parallel range scans over lists of every size from empty up, with bounds on
+* keys, between keys, past either end, empty and reversed, and with up to 16
+* threads, often more than there are chunks. Every element in the range must
+* be visited exactly once and nothing outside it, and the cuts of the range 
+* must be different l0 nodes in order from its first element to its end.
+*/
+
+void check_visit(void *data, void *visits) {
+	__atomic_add_fetch(&((int *)visits)[(long)data / 2], 1, __ATOMIC_RELAXED);
+}
+
+int check_parallel_scan(unsigned int *seed, int rounds) {
+	enum {KEYS = 1024};
+	int model[KEYS] = {0};
+	int visits[KEYS];
+	struct skip_list *sl = skip_list_create(fifo_gt);
+	struct _sl_scan scan;
+	long lo;
+	long hi;
+	long first;
+	long end;
+	int expected;
+	int threads;
+	int count;
+	int failed = 0;
+
+	for(int round = 0; round < rounds / 64 && !failed; ++round) {
+		if(rand_r(seed) % 64 == 0) {
+			skip_list_destroy(sl);
+			sl = skip_list_create(fifo_gt);
+			memset(model, 0, sizeof(model));
+		}
+		for(int update = rand_r(seed) % 32; update > 0; --update) {
+			long k = rand_r(seed) % KEYS;
+
+			if(rand_r(seed) % 2) {
+				skip_list_insert(sl, (void *)(2 * k));
+				model[k] = 1;
+			} else {
+				skip_list_remove(sl, (void *)(2 * k));
+				model[k] = 0;
+			}
+		}
+
+		// keys are even, so odd bounds fall between them; a negative bound 
+		// stands for NULL, and hi is never 0, which would read as NULL
+		lo = (long)(rand_r(seed) % (2 * KEYS + 4)) - 2;
+		hi = -1;
+		if(rand_r(seed) % 4) {
+			hi = lo + (long)(rand_r(seed) % KEYS) - KEYS / 8;
+			hi = hi < 1 ? 1 : hi;
+		}
+		threads = 1 + rand_r(seed) % 16;
+		memset(visits, 0, sizeof(visits));
+		count = skip_list_parallel_for_each(sl, lo < 0 ? NULL : (void *)lo, hi < 0 ? NULL : (void *)hi, check_visit, visits, threads);
+
+		expected = 0;
+		for(long k = 0; k < KEYS; ++k) {
+			int inside = model[k] && (lo < 0 || 2 * k >= lo) && (hi < 0 || 2 * k < hi);
+
+			expected += inside;
+			if(visits[k] != inside) {
+				printf("parallel scan: key %ld visited %d times in [%ld, %ld) with %d threads in round %d\n", 
+					2 * k, visits[k], lo, hi, threads, round);
+				failed = 1;
+				break;
+			}
+		}
+		if(!failed && count != expected) {
+			printf("parallel scan: counted %d of %d in round %d\n", count, expected, round);
+			failed = 1;
+		}
+		if(failed || (lo >= 0 && hi >= 0 && hi <= lo)) {
+			continue;
+		}
+
+		// the cuts of the range, -1 for the end of the list
+		_scan_cut(&scan, sl, lo < 0 ? NULL : (void *)lo, hi < 0 ? NULL : (void *)hi, threads);
+		for(first = lo < 0 ? 0 : (lo + 1) / 2; first < KEYS && !model[first]; ++first);
+		for(end = hi < 0 ? KEYS : (hi + 1) / 2; end < KEYS && !model[end]; ++end);
+		first = first < KEYS ? 2 * first : -1;
+		end = end < KEYS ? 2 * end : -1;
+		if(scan._chunks > expected || !expected != !scan._chunks || 
+				(scan._chunks && (long)scan._cuts[0]->_data != first) || 
+				(scan._cuts[scan._chunks] ? (long)scan._cuts[scan._chunks]->_data : -1) != end) {
+			printf("parallel scan: %d chunks of [%ld, %ld) cut wrong in round %d\n", scan._chunks, lo, hi, round);
+			failed = 1;
+		}
+		for(int chunk = 1; chunk < scan._chunks && !failed; ++chunk) {
+			if(scan._cuts[chunk]->_next_layer || (long)scan._cuts[chunk]->_data <= (long)scan._cuts[chunk - 1]->_data) {
+				printf("parallel scan: cut %d of [%ld, %ld) out of order in round %d\n", chunk, lo, hi, round);
+				failed = 1;
+			}
+		}
+		free(scan._cuts);
+	}
+
+	skip_list_destroy(sl);
+
+	return failed;
+}
+
+/*
+* Replicated lists, with writes between bursts of lookups of every length, 
+* against a model of the keys in the list. A stale copy must not be used, and
+* must only be copied again after as many lookups as it has nodes went to the
+* shared levels instead.
+*/
+int check_replicated(unsigned int *seed, int rounds) {
+	enum {KEYS = 2048};
+	int model[KEYS] = {0};
+	struct skip_list_replicated *rep = skip_list_replicated_create(skip_list_create(fifo_gt), 2, 1);
+	int node = _numa_node() % 2;
+	long k;
+	long waited;
+	int failed = 0;
+
+	for(k = 0; k < KEYS; k += 2) {
+		skip_list_replicated_insert(rep, (void *)k);
+		model[k] = 1;
+	}
+
+	for(int round = 0; round < rounds / 16 && !failed; ++round) {
+		k = rand_r(seed) % KEYS;
+		if(rand_r(seed) % 2) {
+			failed |= skip_list_replicated_insert(rep, (void *)k) != !model[k];
+			model[k] = 1;
+		} else {
+			failed |= skip_list_replicated_remove(rep, (void *)k) != model[k];
+			model[k] = 0;
+		}
+
+		// a stale copy stays stale until enough lookups have passed it over;
+		// writes that change nothing leave the copy current
+		waited = 0;
+		if(rep->_replica_epochs[node] != rep->_epoch) {
+			waited = rep->_rebuild_after[node] - rep->_stale_lookups[node];
+		}
+		for(int lookup = rand_r(seed) % (rand_r(seed) % 8 ? 16 : 4096); lookup > 0 && !failed; --lookup) {
+			k = rand_r(seed) % KEYS;
+			failed |= skip_list_replicated_contains(rep, (void *)k) != model[k];
+			if(rep->_replica_epochs[node] == rep->_epoch) {
+				failed |= waited > 0;
+				waited = 0;
+			} else {
+				failed |= --waited < 0;
+			}
+		}
+		if(failed) {
+			printf("replicated: lookup of %ld wrong in round %d\n", k, round);
+		}
+	}
+
+	skip_list_destroy(skip_list_replicated_destroy(rep));
+
+	return failed;
+}
+
+/*
+* Split and concatenation, on plain, multiset and byte string lists with a
+* filter and a cache in front: random inserts and removes, and splits at a
+* random key after which both halves are changed before they are joined
+* again. Every key is looked up and counted after every step.
+*/
+int check_split_concat(unsigned int *seed, int rounds) {
+	enum {KEYS = 256};
+	static char names[KEYS + 1][32];
+	struct skip_list_bytes keys[KEYS + 1];
+	void *elements[KEYS + 1];
+	int model[KEYS + 1];
+	struct skip_list *sl;
+	struct skip_list *upper;
+	struct skip_list *half;
+	long k;
+	long at = 1;
+	int failed = 0;
+
+	for(int mode = 0; mode < 3 && !failed; ++mode) {
+		for(k = 1; k <= KEYS; ++k) {
+			// half of the byte string keys share a prefix longer than the inline one
+			snprintf(names[k], sizeof(names[k]), k % 2 ? "shared/prefix/%ld" : "%ld", k);
+			keys[k].bytes = names[k];
+			keys[k].length = strlen(names[k]);
+			elements[k] = mode == 2 ? (void *)&keys[k] : (void *)k;
+			model[k] = 0;
+		}
+		sl = mode == 0 ? skip_list_create(fifo_gt) : mode == 1 ? skip_list_create_multiset(fifo_gt) : skip_list_create_bytes();
+		skip_list_set_filter(sl, NULL, 16, 0.01);
+		skip_list_set_cache(sl, NULL, 64);
+		upper = NULL;
+
+		for(int round = 0; round < rounds / 3 && !failed; ++round) {
+			k = 1 + rand_r(seed) % KEYS;
+			half = sl;
+			if(upper && !_SL_GT(sl->_gt_func, elements[at], elements[k])) {
+				half = upper;
+			}
+
+			switch(rand_r(seed) % 8) {
+			case 0: case 1: case 2:
+				failed |= skip_list_insert(half, elements[k]) != (mode == 1 || !model[k]);
+				model[k] = mode == 1 ? model[k] + 1 : 1;
+				break;
+			case 3: case 4:
+				failed |= skip_list_remove(half, elements[k]) != !!model[k];
+				model[k] -= !!model[k];
+				break;
+			case 5: case 6:
+				if(!upper) {
+					at = k;
+					upper = skip_list_split(sl, elements[at]);
+					failed |= !upper || !_same_mode(sl, upper) || !(upper->_filter) || !(upper->_cache);
+				}
+				break;
+			default:
+				if(upper) {
+					failed |= skip_list_concat(sl, upper) != 0;
+					skip_list_destroy(upper);
+					upper = NULL;
+				}
+			}
+			if(failed) {
+				printf("split/concat: operation failed in mode %d round %d\n", mode, round);
+				break;
+			}
+
+			for(k = 1; k <= KEYS && !failed; ++k) {
+				half = upper && !_SL_GT(sl->_gt_func, elements[at], elements[k]) ? upper : sl;
+				if(skip_list_contains(half, elements[k]) != !!model[k] || skip_list_count(half, elements[k]) != model[k]) {
+					printf("split/concat: key %ld wrong in mode %d round %d\n", k, mode, round);
+					failed = 1;
+				}
+			}
+			failed |= check_links(sl, "split/concat lower") || (upper && check_links(upper, "split/concat upper"));
+		}
+
+		if(upper) {
+			skip_list_destroy(upper);
+		}
+		skip_list_destroy(sl);
+	}
+
+	// lists in different modes are not joined
+	sl = skip_list_create(_bytes_gt);
+	upper = skip_list_create_bytes();
+	if(!failed && sl->_seed == upper->_seed) {
+		printf("split/concat: lists created together share the seed of their heights\n");
+		failed = 1;
+	}
+	if(!failed && (skip_list_concat(sl, upper) != -1 || skip_list_merge(upper, sl) != -1)) {
+		printf("split/concat: lists in different modes were joined\n");
+		failed = 1;
+	}
+	skip_list_destroy(sl);
+	skip_list_destroy(upper);
+
+	// lists ordered by deadline have no gt_func to compare their elements with
+	sl = skip_list_create_ttl();
+	upper = skip_list_create_ttl();
+	skip_list_insert_with_deadline(sl, (void *)1, 1);
+	skip_list_insert_with_deadline(upper, (void *)2, 1);
+	if(!failed && (skip_list_merge(sl, upper) != -1 || skip_list_concat(sl, upper) != -1 ||
+			skip_list_split(sl, (void *)1) || skip_list_remove_range(sl, (void *)0, (void *)2) ||
+			skip_list_union(sl, upper) || skip_list_intersect_each(sl, upper, NULL, NULL))) {
+		printf("split/concat: lists ordered by deadline were compared\n");
+		failed = 1;
+	}
+	skip_list_destroy(sl);
+	skip_list_destroy(upper);
+
+	return failed;
+}
+
+/*
+* Intersection, union and difference of random sets, on plain, multiset and
+* byte string lists. The results must hold exactly the keys of the model, in
+* the mode of the first list, and keep working as lists of that mode when 
+* more keys are inserted and they are merged back into it.
+*/
+int check_set_operations(unsigned int *seed, int rounds) {
+	enum {KEYS = 128};
+	static char names[KEYS + 1][32];
+	struct skip_list_bytes keys[KEYS + 1];
+	void *elements[KEYS + 1];
+	int in_a[KEYS + 1];
+	int in_b[KEYS + 1];
+	int expected;
+	struct skip_list *a;
+	struct skip_list *b;
+	struct skip_list *result;
+	long k;
+	int failed = 0;
+
+	for(int round = 0; round < rounds / 100 && !failed; ++round) {
+		int mode = round % 3;
+
+		for(k = 1; k <= KEYS; ++k) {
+			snprintf(names[k], sizeof(names[k]), k % 2 ? "shared/prefix/%ld" : "%ld", k);
+			keys[k].bytes = names[k];
+			keys[k].length = strlen(names[k]);
+			elements[k] = mode == 2 ? (void *)&keys[k] : (void *)k;
+		}
+		a = mode == 0 ? skip_list_create(fifo_gt) : mode == 1 ? skip_list_create_multiset(fifo_gt) : skip_list_create_bytes();
+		b = mode == 0 ? skip_list_create(fifo_gt) : mode == 1 ? skip_list_create_multiset(fifo_gt) : skip_list_create_bytes();
+		for(k = 1; k <= KEYS; ++k) {
+			in_a[k] = rand_r(seed) % 3 == 0;
+			in_b[k] = rand_r(seed) % 3 == 0;
+			for(int copy = 0; copy < in_a[k] * (mode == 1 ? 1 + rand_r(seed) % 3 : 1); ++copy) {
+				skip_list_insert(a, elements[k]);
+			}
+			if(in_b[k]) {
+				skip_list_insert(b, elements[k]);
+			}
+		}
+
+		for(int op = 0; op < 3 && !failed; ++op) {
+			result = op == 0 ? skip_list_intersect(a, b) : op == 1 ? skip_list_union(a, b) : skip_list_difference(a, b);
+			if(!_same_mode(a, result) || check_links(result, "set operations")) {
+				printf("set operations: result of operation %d in mode %d malformed\n", op, mode);
+				failed = 1;
+			}
+
+			// the result must take more keys, then go back into a list like a
+			for(k = 1; k <= KEYS && !failed; k += 7) {
+				expected = op == 0 ? in_a[k] && in_b[k] : op == 1 ? in_a[k] || in_b[k] : in_a[k] && !in_b[k];
+				if(skip_list_count(result, elements[k]) != expected) {
+					printf("set operations: key %ld wrong after operation %d in mode %d\n", k, op, mode);
+					failed = 1;
+				}
+				skip_list_insert(result, elements[k]);
+			}
+			for(k = 1; k <= KEYS && !failed; ++k) {
+				expected = op == 0 ? in_a[k] && in_b[k] : op == 1 ? in_a[k] || in_b[k] : in_a[k] && !in_b[k];
+				expected = k % 7 == 1 ? (mode == 1 ? expected + 1 : 1) : expected;
+				if(skip_list_contains(result, elements[k]) != !!expected || skip_list_count(result, elements[k]) != expected) {
+					printf("set operations: key %ld lost after operation %d in mode %d\n", k, op, mode);
+					failed = 1;
+				}
+			}
+
+			// a is not needed after the last operation
+			if(!failed && op == 2) {
+				skip_list_merge(a, result);
+				for(k = 1; k <= KEYS && !failed; ++k) {
+					if(skip_list_contains(a, elements[k]) != (in_a[k] || k % 7 == 1)) {
+						printf("set operations: key %ld wrong after merging in mode %d\n", k, mode);
+						failed = 1;
+					}
+				}
+				failed |= check_links(a, "set operations merged");
+			}
+			skip_list_destroy(result);
+		}
+
+		skip_list_destroy(a);
+		skip_list_destroy(b);
+	}
+
+	return failed;
+}
+
+/*
+* An allocator that fails one allocation in odds and counts the blocks and 
+* bytes it has handed out and not got back, so that a block freed with 
+* another size than it was allocated with is noticed.
+*/
+struct check_budget {
+	unsigned int seed;
+	int odds;
+	long live;
+	long bytes;
+};
+
+void *check_budget_alloc(size_t size, void *ctx) {
+	struct check_budget *budget = (struct check_budget *)ctx;
+
+	if(!(rand_r(&(budget->seed)) % budget->odds)) {
+		return NULL;
+	}
+	++(budget->live);
+	budget->bytes += (long)size;
+	return malloc(size);
+}
+
+void check_budget_free(void *ptr, size_t size, void *ctx) {
+	--(((struct check_budget *)ctx)->live);
+	((struct check_budget *)ctx)->bytes -= (long)size;
+	free(ptr);
+}
+
+/*
+* Lists whose allocator fails one allocation in eight: random inserts, 
+* removes, splits with the halves joined again, unions that are then
+* augmented, and intervals. An 
+* operation that runs out of memory must report it and leave the lists as 
+* they were, and every block must be given back once they are destroyed.
+*/
+int check_allocator(unsigned int *seed, int rounds) {
+	enum {KEYS = 128, SLOTS = 32};
+	struct check_budget budget = {*seed, 8, 0, 0};
+	struct skip_list_monoid sum = {0, check_sum, check_value};
+	struct skip_list_allocator allocator = {check_budget_alloc, check_budget_free, &budget};
+	struct skip_list *sl = skip_list_create(fifo_gt);
+	struct skip_list *intervals = skip_list_create_interval(fifo_gt);
+	struct skip_list *other;
+	struct skip_list_interval *handles[SLOTS] = {NULL};
+	long lo[SLOTS];
+	long hi[SLOTS];
+	int model[KEYS + 1] = {0};
+	int expected;
+	int result;
+	int slot;
+	long k;
+	int failed = 0;
+
+	while(!skip_list_set_allocator(sl, &allocator));
+	while(!skip_list_set_allocator(intervals, &allocator));
+
+	for(int round = 0; round < rounds / 4 && !failed; ++round) {
+		k = 1 + rand_r(seed) % KEYS;
+		switch(rand_r(seed) % 4) {
+		case 0:
+			result = skip_list_insert(sl, (void *)k);
+			failed |= model[k] ? result != 0 : result == 0;
+			model[k] |= result == 1;
+			break;
+		case 1:
+			failed |= skip_list_remove(sl, (void *)k) != model[k];
+			model[k] = 0;
+			break;
+		case 2:
+			other = skip_list_split(sl, (void *)k);
+			while(other && !failed && skip_list_concat(sl, other)) {
+				failed |= check_links(sl, "allocator concat") || check_links(other, "allocator concat");
+			}
+			if(other) {
+				skip_list_destroy(other);
+			}
+			break;
+		default:
+			other = skip_list_union(sl, sl);
+			for(k = 1; other && k <= KEYS; ++k) {
+				failed |= skip_list_contains(other, (void *)k) != model[k];
+			}
+			if(other) {
+				skip_list_set_aggregate(other, &sum);	// moves the upper nodes if it can
+				failed |= check_links(other, "allocator union");
+				skip_list_destroy(other);
+			}
+		}
+
+		slot = rand_r(seed) % SLOTS;
+		if(handles[slot]) {
+			failed |= skip_list_interval_remove(intervals, handles[slot]) != 1;
+			handles[slot] = NULL;
+		} else {
+			lo[slot] = 1 + rand_r(seed) % KEYS;
+			hi[slot] = lo[slot] + rand_r(seed) % (rand_r(seed) % 2 ? 4 : KEYS);
+			handles[slot] = skip_list_interval_insert(intervals, (void *)lo[slot], (void *)hi[slot], NULL);
+		}
+
+		for(k = 1; k <= KEYS; ++k) {
+			failed |= skip_list_contains(sl, (void *)k) != model[k];
+		}
+		for(int query = 0; query < 8; ++query) {
+			k = rand_r(seed) % (2 * KEYS);
+			expected = 0;
+			for(slot = 0; slot < SLOTS; ++slot) {
+				expected += handles[slot] && lo[slot] <= k && k <= hi[slot];
+			}
+			failed |= skip_list_stab(intervals, (void *)k, NULL, NULL) != expected;
+		}
+		if(failed || check_links(sl, "allocator") || check_links(intervals, "allocator intervals")) {
+			printf("allocator: wrong answer in round %d\n", round);
+			failed = 1;
+		}
+	}
+
+	skip_list_destroy(sl);
+	skip_list_destroy(intervals);
+	if(!failed && (budget.live || budget.bytes)) {
+		printf("allocator: %ld blocks, %ld bytes not given back\n", budget.live, budget.bytes);
+		failed = 1;
+	}
+
+	return failed;
+}
+
+/*
+* Destroying a long list, built by skip_list_build_parallel() so that l0 is 
+* one long run, must not need stack in proportion to its length.
+*/
+int check_destroy(unsigned int *seed, int rounds) {
+	long elements = 20L * rounds;
+	void **data = (void **)malloc(elements * sizeof(void *));
+	struct skip_list *sl;
+	int failed;
+
+	for(long i = 0; i < elements; ++i) {
+		data[i] = (void *)(long)rand_r(seed);
+	}
+	sl = skip_list_build_parallel(fifo_gt, data, (int)elements, 4);
+	failed = check_links(sl, "destroy");
+	skip_list_destroy(sl);
+	free(data);
+
+	return failed;
+}
+
+int main(int argc, char **argv) {
+	struct skip_list *test_list;
+	struct skip_list_stats stats;
+
+	// ./skiplist bench [threads] runs the concurrent pop-min benchmark
+	if(argc > 1 && !strcmp(argv[1], "bench")) {
+		bench_pop_min(argc > 2 ? atoi(argv[2]) : 8);
+		return 0;
+	}
+
+	// ./skiplist numa [threads] runs the replicated lookup benchmark
+	if(argc > 1 && !strcmp(argv[1], "numa")) {
+		bench_numa(argc > 2 ? atoi(argv[2]) : 8);
+		return 0;
+	}
+
+	// ./skiplist check [rounds] [seed] runs the randomized checks
+	if(argc > 1 && !strcmp(argv[1], "check")) {
+		int rounds = argc > 2 ? atoi(argv[2]) : 20000;
+		unsigned int seed = argc > 3 ? (unsigned int)atoi(argv[3]) : (unsigned int)time(NULL);
+		int failed = 0;
+
+		printf("seed %u\n", seed);
+		failed |= check_mvcc(&seed, rounds);
+		failed |= check_split_concat(&seed, rounds);
+		failed |= check_set_operations(&seed, rounds);
+		failed |= check_aggregate(&seed, rounds);
+		failed |= check_intervals(&seed, rounds);
+		failed |= check_bytes(&seed, rounds);
+		failed |= check_intrusive(&seed, rounds);
+		failed |= check_compact(&seed, rounds);
+		failed |= check_parallel_scan(&seed, rounds);
+		failed |= check_replicated(&seed, rounds);
+		failed |= check_allocator(&seed, rounds);
+		failed |= check_destroy(&seed, rounds);
+		printf(failed ? "FAILED\n" : "ok\n");
+		return failed;
+	}
+
+	test_list = skip_list_create(fifo_gt);
+
+	for(long i = 0; i < 30; i += 2)
+	{
+		skip_list_insert(test_list, (void *)i);
+	}
+
+	for(long j = 0; j < 30; ++j)
+	{
+		printf("Contains %ld: %d\n", j, skip_list_contains(test_list, (void *)j));
 	}
 
 	skip_list_print(test_list);
@@ -501,6 +7975,11 @@ int main() {
 	printf("\n");
 	skip_list_print(test_list);
 
+	skip_list_stats(test_list, &stats);
+	printf("\nLevels: %d Size: %d Bytes: %zu Search path: %.1f (max %d) Comparisons: %.1f\n",
+		stats.levels, stats.size, stats.total_bytes, stats.avg_search_path, 
+		stats.max_search_path, stats.avg_comparisons);
+
 	skip_list_destroy(test_list);
 
 	return 0;
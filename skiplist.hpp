@@ -0,0 +1,1123 @@
+
+/*
+* File: 	skiplist.hpp
+* Description:	Header-only C++17 versions of the skip list in skiplist.c.
+*		SkipList<Key, Compare, Allocator> follows the interface of
+*		std::set and SkipMap<Key, T, Compare, Allocator> the interface
+*		of std::map.
+*
+*		The algorithm is the one of skiplist.c: every level is a
+*		doubly linked sublist, the nodes of a tower are linked up and
+*		down, searches start on the top sublist and step down when the
+*		next node is not less than the key, and the height of a new
+*		tower is decided by coin flips, with a new sublist added on top
+*		whenever a tower outgrows the list. The comparator is a type
+*		parameter, so it is inlined into the search loops, and the
+*		element is constructed in place inside its l0 node; the upper
+*		nodes of a tower point back to that node for the key.
+*
+*		Nodes are allocated through the Allocator parameter rebound to
+*		the node types, so any standard allocator works, including the
+*		std::pmr ones used by skiplist::pmr::SkipList and SkipMap.
+*
+*		Insertion is exception safe: the element and every node of its
+*		tower are allocated, and the position is searched for, before
+*		anything is linked, so a throwing constructor, comparator or
+*		allocator leaves the container unchanged.
+*
+*		skiplist_check.cpp runs the containers against std::set and
+*		std::map.
+*/
+
+#ifndef SKIPLIST_HPP
+#define SKIPLIST_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#if __has_include(<memory_resource>)
+#include <memory_resource>
+#endif
+#include <new>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace skiplist {
+
+namespace detail {
+
+/* link
+* A skip list node as seen by the algorithm: accessible from 4 directions, plus
+* a pointer to the l0 node of its tower, which holds the element. Headers have
+* no element and _base is nullptr.
+*/
+
+struct link {
+	link *_prev;
+	link *_next;
+	link *_up;
+	link *_down;
+	link *_base;
+};
+
+/* node
+* The l0 node of a tower, with room for the element constructed in place.
+*/
+
+template<class Value>
+struct node : link {
+	alignas(Value) unsigned char _storage[sizeof(Value)];
+
+	Value *valptr() noexcept {
+		return std::launder(reinterpret_cast<Value *>(_storage));
+	}
+	Value &value() noexcept {
+		return *valptr();
+	}
+};
+
+/* identity_key, select_first
+* Extract the key from an element of a SkipList and of a SkipMap.
+*/
+
+struct identity_key {
+	template<class V>
+	const V &operator()(const V &value) const noexcept {
+		return value;
+	}
+};
+
+struct select_first {
+	template<class P>
+	const typename P::first_type &operator()(const P &value) const noexcept {
+		return value.first;
+	}
+};
+
+template<class Value, class KeyOfValue, class Compare, class Allocator, bool ConstIterator>
+class skip_list_impl;
+
+/* iterator
+* Bidirectional iterator over l0. The end iterator holds no node, so stepping
+* back from it reads the last node from the container.
+*/
+
+template<class Value, bool Const>
+class iterator {
+public:
+	using iterator_category = std::bidirectional_iterator_tag;
+	using value_type = Value;
+	using difference_type = std::ptrdiff_t;
+	using pointer = std::conditional_t<Const, const Value *, Value *>;
+	using reference = std::conditional_t<Const, const Value &, Value &>;
+
+	iterator() noexcept : _node(nullptr), _last(nullptr) {}
+
+	template<bool C = Const, class = std::enable_if_t<C>>
+	iterator(const iterator<Value, false> &other) noexcept : _node(other._node), _last(other._last) {}
+
+	reference operator*() const noexcept {
+		return static_cast<node<Value> *>(_node)->value();
+	}
+	pointer operator->() const noexcept {
+		return static_cast<node<Value> *>(_node)->valptr();
+	}
+
+	iterator &operator++() noexcept {
+		_node = _node->_next;
+		return *this;
+	}
+	iterator operator++(int) noexcept {
+		iterator old = *this;
+		_node = _node->_next;
+		return old;
+	}
+	iterator &operator--() noexcept {
+		_node = _node ? _node->_prev : *_last;
+		return *this;
+	}
+	iterator operator--(int) noexcept {
+		iterator old = *this;
+		--(*this);
+		return old;
+	}
+
+	friend bool operator==(const iterator &a, const iterator &b) noexcept {
+		return a._node == b._node;
+	}
+	friend bool operator!=(const iterator &a, const iterator &b) noexcept {
+		return a._node != b._node;
+	}
+
+private:
+	template<class, bool> friend class iterator;
+	template<class, class, class, class, bool> friend class skip_list_impl;
+
+	iterator(link *node, link *const *last) noexcept : _node(node), _last(last) {}
+
+	link *_node;		// l0 node, nullptr at the end
+	link *const *_last;	// last l0 node of the container
+};
+
+/* skip_list_impl
+* The container shared by SkipList and SkipMap, which differ in the element
+* type, in how the key is read from an element and in whether iterators may
+* modify the element.
+*/
+
+template<class Value, class KeyOfValue, class Compare, class Allocator, bool ConstIterator>
+class skip_list_impl {
+public:
+	using key_type = std::remove_cv_t<std::remove_reference_t<decltype(KeyOfValue()(std::declval<const Value &>()))>>;
+	using value_type = Value;
+	using size_type = std::size_t;
+	using difference_type = std::ptrdiff_t;
+	using key_compare = Compare;
+	using allocator_type = Allocator;
+	using reference = value_type &;
+	using const_reference = const value_type &;
+	using pointer = typename std::allocator_traits<Allocator>::pointer;
+	using const_pointer = typename std::allocator_traits<Allocator>::const_pointer;
+	using const_iterator = detail::iterator<Value, true>;
+	using iterator = std::conditional_t<ConstIterator, const_iterator, detail::iterator<Value, false>>;
+	using reverse_iterator = std::reverse_iterator<iterator>;
+	using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+	class value_compare {
+	public:
+		bool operator()(const value_type &a, const value_type &b) const {
+			return _comp(KeyOfValue()(a), KeyOfValue()(b));
+		}
+	protected:
+		friend class skip_list_impl;
+		value_compare(Compare comp) : _comp(comp) {}
+		Compare _comp;
+	};
+
+	static constexpr int max_height = 64;	// tallest tower, in levels
+
+	// construction and destruction
+
+	skip_list_impl() : skip_list_impl(Compare()) {}
+
+	explicit skip_list_impl(const Compare &comp, const Allocator &alloc = Allocator())
+		: _comp(comp), _alloc(alloc), _seed(_make_seed()) {}
+
+	explicit skip_list_impl(const Allocator &alloc) : skip_list_impl(Compare(), alloc) {}
+
+	template<class InputIt>
+	skip_list_impl(InputIt first, InputIt last, const Compare &comp = Compare(), const Allocator &alloc = Allocator())
+		: skip_list_impl(comp, alloc) {
+		insert(first, last);
+	}
+
+	template<class InputIt>
+	skip_list_impl(InputIt first, InputIt last, const Allocator &alloc)
+		: skip_list_impl(first, last, Compare(), alloc) {}
+
+	skip_list_impl(std::initializer_list<value_type> values, const Compare &comp = Compare(), const Allocator &alloc = Allocator())
+		: skip_list_impl(values.begin(), values.end(), comp, alloc) {}
+
+	skip_list_impl(std::initializer_list<value_type> values, const Allocator &alloc)
+		: skip_list_impl(values.begin(), values.end(), Compare(), alloc) {}
+
+	skip_list_impl(const skip_list_impl &other)
+		: skip_list_impl(other, alloc_traits::select_on_container_copy_construction(other._alloc)) {}
+
+	/*
+	* The constructors that fill the list delegate to an empty one first, so
+	* the destructor frees whatever was built when filling it throws.
+	*/
+	skip_list_impl(const skip_list_impl &other, const Allocator &alloc) : skip_list_impl(other._comp, alloc) {
+		_append_all(other.begin(), other.end());
+	}
+
+	skip_list_impl(skip_list_impl &&other) noexcept
+		: _comp(other._comp), _alloc(std::move(other._alloc)), _seed(other._seed) {
+		_steal(other);
+	}
+
+	skip_list_impl(skip_list_impl &&other, const Allocator &alloc) : skip_list_impl(other._comp, alloc) {
+		if(_alloc == other._alloc) {
+			_steal(other);
+			return;
+		}
+		_move_all(other);
+	}
+
+	~skip_list_impl() {
+		clear();
+	}
+
+	skip_list_impl &operator=(const skip_list_impl &other) {
+		if(this == &other) {
+			return *this;
+		}
+
+		clear();
+		if constexpr(alloc_traits::propagate_on_container_copy_assignment::value) {
+			_alloc = other._alloc;
+		}
+		_comp = other._comp;
+		_append_all(other.begin(), other.end());
+		return *this;
+	}
+
+	skip_list_impl &operator=(skip_list_impl &&other) noexcept(
+			alloc_traits::propagate_on_container_move_assignment::value || alloc_traits::is_always_equal::value) {
+		if(this == &other) {
+			return *this;
+		}
+
+		clear();
+		_comp = other._comp;
+		if constexpr(alloc_traits::propagate_on_container_move_assignment::value) {
+			_alloc = std::move(other._alloc);
+		} else if(!(_alloc == other._alloc)) {
+			// the nodes belong to another allocator, so only the elements move
+			_move_all(other);
+			return *this;
+		}
+		_steal(other);
+		return *this;
+	}
+
+	skip_list_impl &operator=(std::initializer_list<value_type> values) {
+		clear();
+		insert(values.begin(), values.end());
+		return *this;
+	}
+
+	allocator_type get_allocator() const noexcept {
+		return _alloc;
+	}
+
+	// iterators
+
+	iterator begin() noexcept {
+		return _begin();
+	}
+	const_iterator begin() const noexcept {
+		return const_cast<skip_list_impl *>(this)->_begin();
+	}
+	const_iterator cbegin() const noexcept {
+		return begin();
+	}
+	iterator end() noexcept {
+		return _end();
+	}
+	const_iterator end() const noexcept {
+		return const_cast<skip_list_impl *>(this)->_end();
+	}
+	const_iterator cend() const noexcept {
+		return end();
+	}
+	reverse_iterator rbegin() noexcept {
+		return reverse_iterator(end());
+	}
+	const_reverse_iterator rbegin() const noexcept {
+		return const_reverse_iterator(end());
+	}
+	const_reverse_iterator crbegin() const noexcept {
+		return rbegin();
+	}
+	reverse_iterator rend() noexcept {
+		return reverse_iterator(begin());
+	}
+	const_reverse_iterator rend() const noexcept {
+		return const_reverse_iterator(begin());
+	}
+	const_reverse_iterator crend() const noexcept {
+		return rend();
+	}
+
+	// capacity
+
+	bool empty() const noexcept {
+		return _size == 0;
+	}
+	size_type size() const noexcept {
+		return _size;
+	}
+	size_type max_size() const noexcept {
+		return node_traits::max_size(node_alloc(_alloc));
+	}
+
+	// modifiers
+
+	void clear() noexcept {
+		link *head_node = _top;
+		link *current_node;
+		link *next_node;
+		link *below;
+
+		while(head_node) {
+			below = head_node->_down;
+			for(current_node = head_node->_next; current_node; current_node = next_node) {
+				next_node = current_node->_next;
+				if(below) {
+					_free_link(current_node);
+				} else {
+					_destroy_node(static_cast<node_type *>(current_node));
+				}
+			}
+			_free_link(head_node);
+			head_node = below;
+		}
+
+		_top = _base = _last = nullptr;
+		_levels = 0;
+		_size = 0;
+	}
+
+	std::pair<iterator, bool> insert(const value_type &value) {
+		return emplace(value);
+	}
+	std::pair<iterator, bool> insert(value_type &&value) {
+		return emplace(std::move(value));
+	}
+	iterator insert(const_iterator hint, const value_type &value) {
+		return emplace_hint(hint, value);
+	}
+	iterator insert(const_iterator hint, value_type &&value) {
+		return emplace_hint(hint, std::move(value));
+	}
+	template<class InputIt>
+	void insert(InputIt first, InputIt last) {
+		// sorted input keeps hitting the end hint and is appended in O(1)
+		for(; first != last; ++first) {
+			emplace_hint(cend(), *first);
+		}
+	}
+	void insert(std::initializer_list<value_type> values) {
+		insert(values.begin(), values.end());
+	}
+
+	template<class... Args>
+	std::pair<iterator, bool> emplace(Args &&...args) {
+		return _insert_unique(_create_node(std::forward<Args>(args)...));
+	}
+
+	/*
+	* Inserts next to hint when the element belongs right before it. The
+	* predecessors on the upper levels are found by walking back from hint
+	* on each level until a taller tower, which takes O(1) expected steps
+	* for the levels a new tower usually reaches.
+	*/
+	template<class... Args>
+	iterator emplace_hint(const_iterator hint, Args &&...args) {
+		node_type *new_node = _create_node(std::forward<Args>(args)...);
+		link *preds[max_height];
+		link *prev_node;
+		int height;
+		int level;
+		bool fits;
+
+		try {
+			_ensure_head();
+			prev_node = hint._node ? hint._node->_prev : (_last ? _last : _base);
+			fits = (prev_node == _base || _comp(_key(prev_node), _key(new_node))) &&
+					(!hint._node || _comp(_key(new_node), _key(hint._node)));
+		} catch(...) {
+			_destroy_node(new_node);
+			throw;
+		}
+		if(!fits) {
+			return _insert_unique(new_node).first;
+		}
+
+		try {
+			height = _random_height();
+			preds[0] = prev_node;
+			for(level = 1; level < height && level < _levels; ++level) {
+				for(prev_node = preds[level - 1]; !prev_node->_up; prev_node = prev_node->_prev);
+				preds[level] = prev_node->_up;
+			}
+			_link_node(new_node, preds, height);
+		} catch(...) {
+			_destroy_node(new_node);
+			throw;
+		}
+
+		return _make_iterator(new_node);
+	}
+
+	iterator erase(const_iterator pos) noexcept {
+		link *del_node = pos._node;
+		link *next_node = del_node->_next;
+		link *tower_node = del_node;
+		link *up_node;
+
+		// unlink every node of the tower
+		while(tower_node) {
+			up_node = tower_node->_up;
+			tower_node->_prev->_next = tower_node->_next;
+			if(tower_node->_next) {
+				tower_node->_next->_prev = tower_node->_prev;
+			}
+			if(tower_node != del_node) {
+				_free_link(tower_node);
+			}
+			tower_node = up_node;
+		}
+
+		if(del_node == _last) {
+			_last = del_node->_prev == _base ? nullptr : del_node->_prev;
+		}
+		_destroy_node(static_cast<node_type *>(del_node));
+		--_size;
+		_reduce_height();
+
+		return _make_iterator(next_node);
+	}
+
+	iterator erase(const_iterator first, const_iterator last) noexcept {
+		while(first != last) {
+			first = erase(first);
+		}
+		return _make_iterator(last._node);
+	}
+
+	size_type erase(const key_type &key) {
+		const_iterator pos = find(key);
+
+		if(pos == end()) {
+			return 0;
+		}
+		erase(pos);
+		return 1;
+	}
+
+	void swap(skip_list_impl &other) noexcept(alloc_traits::is_always_equal::value && std::is_nothrow_swappable_v<Compare>) {
+		using std::swap;
+
+		if constexpr(alloc_traits::propagate_on_container_swap::value) {
+			swap(_alloc, other._alloc);
+		}
+		swap(_comp, other._comp);
+		swap(_top, other._top);
+		swap(_base, other._base);
+		swap(_last, other._last);
+		swap(_levels, other._levels);
+		swap(_size, other._size);
+	}
+
+	friend void swap(skip_list_impl &a, skip_list_impl &b) noexcept(noexcept(a.swap(b))) {
+		a.swap(b);
+	}
+
+	// lookup; the templates take any key the comparator is transparent for
+
+	size_type count(const key_type &key) const {
+		return find(key) != end();
+	}
+	template<class K, class C = Compare, class = typename C::is_transparent>
+	size_type count(const K &key) const {
+		return find(key) != end();
+	}
+
+	bool contains(const key_type &key) const {
+		return find(key) != end();
+	}
+	template<class K, class C = Compare, class = typename C::is_transparent>
+	bool contains(const K &key) const {
+		return find(key) != end();
+	}
+
+	iterator find(const key_type &key) {
+		return _find(key);
+	}
+	const_iterator find(const key_type &key) const {
+		return const_cast<skip_list_impl *>(this)->_find(key);
+	}
+	template<class K, class C = Compare, class = typename C::is_transparent>
+	iterator find(const K &key) {
+		return _find(key);
+	}
+	template<class K, class C = Compare, class = typename C::is_transparent>
+	const_iterator find(const K &key) const {
+		return const_cast<skip_list_impl *>(this)->_find(key);
+	}
+
+	iterator lower_bound(const key_type &key) {
+		return _lower_bound(key);
+	}
+	const_iterator lower_bound(const key_type &key) const {
+		return const_cast<skip_list_impl *>(this)->_lower_bound(key);
+	}
+	template<class K, class C = Compare, class = typename C::is_transparent>
+	iterator lower_bound(const K &key) {
+		return _lower_bound(key);
+	}
+	template<class K, class C = Compare, class = typename C::is_transparent>
+	const_iterator lower_bound(const K &key) const {
+		return const_cast<skip_list_impl *>(this)->_lower_bound(key);
+	}
+
+	iterator upper_bound(const key_type &key) {
+		return _upper_bound(key);
+	}
+	const_iterator upper_bound(const key_type &key) const {
+		return const_cast<skip_list_impl *>(this)->_upper_bound(key);
+	}
+	template<class K, class C = Compare, class = typename C::is_transparent>
+	iterator upper_bound(const K &key) {
+		return _upper_bound(key);
+	}
+	template<class K, class C = Compare, class = typename C::is_transparent>
+	const_iterator upper_bound(const K &key) const {
+		return const_cast<skip_list_impl *>(this)->_upper_bound(key);
+	}
+
+	std::pair<iterator, iterator> equal_range(const key_type &key) {
+		return {lower_bound(key), upper_bound(key)};
+	}
+	std::pair<const_iterator, const_iterator> equal_range(const key_type &key) const {
+		return {lower_bound(key), upper_bound(key)};
+	}
+	template<class K, class C = Compare, class = typename C::is_transparent>
+	std::pair<iterator, iterator> equal_range(const K &key) {
+		return {lower_bound(key), upper_bound(key)};
+	}
+	template<class K, class C = Compare, class = typename C::is_transparent>
+	std::pair<const_iterator, const_iterator> equal_range(const K &key) const {
+		return {lower_bound(key), upper_bound(key)};
+	}
+
+	// observers
+
+	key_compare key_comp() const {
+		return _comp;
+	}
+	value_compare value_comp() const {
+		return value_compare(_comp);
+	}
+
+	friend bool operator==(const skip_list_impl &a, const skip_list_impl &b) {
+		return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin());
+	}
+	friend bool operator!=(const skip_list_impl &a, const skip_list_impl &b) {
+		return !(a == b);
+	}
+	friend bool operator<(const skip_list_impl &a, const skip_list_impl &b) {
+		return std::lexicographical_compare(a.begin(), a.end(), b.begin(), b.end());
+	}
+	friend bool operator>(const skip_list_impl &a, const skip_list_impl &b) {
+		return b < a;
+	}
+	friend bool operator<=(const skip_list_impl &a, const skip_list_impl &b) {
+		return !(b < a);
+	}
+	friend bool operator>=(const skip_list_impl &a, const skip_list_impl &b) {
+		return !(a < b);
+	}
+
+protected:
+	using node_type = node<Value>;
+	using alloc_traits = std::allocator_traits<Allocator>;
+	using node_alloc = typename alloc_traits::template rebind_alloc<node_type>;
+	using node_traits = std::allocator_traits<node_alloc>;
+	using link_alloc = typename alloc_traits::template rebind_alloc<link>;
+	using link_traits = std::allocator_traits<link_alloc>;
+
+	static const key_type &_key(const link *node) noexcept {
+		return KeyOfValue()(static_cast<node_type *>(node->_base)->value());
+	}
+
+	iterator _make_iterator(link *node) noexcept {
+		return iterator(node, &_last);
+	}
+	iterator _begin() noexcept {
+		return _make_iterator(_base ? _base->_next : nullptr);
+	}
+	iterator _end() noexcept {
+		return _make_iterator(nullptr);
+	}
+
+	/*
+	* Returns the last l0 node less than key and stores the last node less
+	* than key on every level in preds, l0 first, when preds is not null.
+	* The list must have a header.
+	*/
+	template<class K>
+	link *_find_previous(const K &key, link **preds) const {
+		link *current_node = _top;
+		int level = _levels - 1;
+
+		for(;;) {
+			while(current_node->_next && _comp(_key(current_node->_next), key)) {
+				current_node = current_node->_next;
+			}
+			if(preds) {
+				preds[level] = current_node;
+			}
+			if(!current_node->_down) {
+				return current_node;
+			}
+			current_node = current_node->_down;
+			--level;
+		}
+	}
+
+	template<class K>
+	iterator _lower_bound(const K &key) {
+		if(!_top) {
+			return _end();
+		}
+		return _make_iterator(_find_previous(key, nullptr)->_next);
+	}
+
+	template<class K>
+	iterator _upper_bound(const K &key) {
+		link *current_node = _top;
+
+		if(!current_node) {
+			return _end();
+		}
+		for(;;) {
+			while(current_node->_next && !_comp(key, _key(current_node->_next))) {
+				current_node = current_node->_next;
+			}
+			if(!current_node->_down) {
+				return _make_iterator(current_node->_next);
+			}
+			current_node = current_node->_down;
+		}
+	}
+
+	template<class K>
+	iterator _find(const K &key) {
+		iterator pos = _lower_bound(key);
+
+		if(pos._node && _comp(key, _key(pos._node))) {
+			return _end();
+		}
+		return pos;
+	}
+
+	/*
+	* Searches for the place of a node whose element is already built and
+	* links it there. The node is freed if its key is taken or if anything
+	* throws.
+	*/
+	std::pair<iterator, bool> _insert_unique(node_type *new_node) {
+		link *preds[max_height];
+		link *prev_node;
+
+		try {
+			_ensure_head();
+			prev_node = _find_previous(_key(new_node), preds);
+			if(prev_node->_next && !_comp(_key(new_node), _key(prev_node->_next))) {
+				_destroy_node(new_node);
+				return {_make_iterator(prev_node->_next), false};
+			}
+			_link_node(new_node, preds, _random_height());
+		} catch(...) {
+			_destroy_node(new_node);
+			throw;
+		}
+
+		return {_make_iterator(new_node), true};
+	}
+
+	/*
+	* The coin flips of skiplist.c, taken from one xorshift draw: the tower
+	* grows by one level for every trailing 1 bit.
+	*/
+	int _random_height() noexcept {
+		std::uint64_t bits;
+		int height = 1;
+
+		_seed ^= _seed << 13;
+		_seed ^= _seed >> 7;
+		_seed ^= _seed << 17;
+		for(bits = _seed; height < max_height && (bits & 1); bits >>= 1) {
+			++height;
+		}
+
+		return height;
+	}
+
+	std::uint64_t _make_seed() const noexcept {
+		std::uint64_t seed = static_cast<std::uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+
+		seed ^= reinterpret_cast<std::uintptr_t>(this);
+		return seed ? seed : 0x9e3779b97f4a7c15ULL;
+	}
+
+	link *_make_link() {
+		link_alloc alloc(_alloc);
+		link *new_link = std::addressof(*link_traits::allocate(alloc, 1));
+
+		return ::new(static_cast<void *>(new_link)) link{};
+	}
+
+	void _free_link(link *old_link) noexcept {
+		link_alloc alloc(_alloc);
+
+		link_traits::deallocate(alloc, std::pointer_traits<typename link_traits::pointer>::pointer_to(*old_link), 1);
+	}
+
+	template<class... Args>
+	node_type *_create_node(Args &&...args) {
+		node_alloc alloc(_alloc);
+		node_type *new_node = std::addressof(*node_traits::allocate(alloc, 1));
+
+		::new(static_cast<void *>(new_node)) node_type;
+		new_node->_prev = new_node->_next = new_node->_up = new_node->_down = nullptr;
+		new_node->_base = new_node;
+		try {
+			alloc_traits::construct(_alloc, reinterpret_cast<Value *>(new_node->_storage), std::forward<Args>(args)...);
+		} catch(...) {
+			node_traits::deallocate(alloc, std::pointer_traits<typename node_traits::pointer>::pointer_to(*new_node), 1);
+			throw;
+		}
+
+		return new_node;
+	}
+
+	void _destroy_node(node_type *old_node) noexcept {
+		node_alloc alloc(_alloc);
+
+		alloc_traits::destroy(_alloc, old_node->valptr());
+		old_node->~node_type();
+		node_traits::deallocate(alloc, std::pointer_traits<typename node_traits::pointer>::pointer_to(*old_node), 1);
+	}
+
+	void _ensure_head() {
+		if(!_top) {
+			_top = _base = _make_link();
+			_levels = 1;
+		}
+	}
+
+	/*
+	* Links a new tower of the given height for new_node after the nodes in
+	* preds, which must hold the predecessor on every level below the height
+	* that the list already has. Everything the tower needs is allocated
+	* first; once linking starts nothing can throw.
+	*/
+	void _link_node(node_type *new_node, link **preds, int height) {
+		link *tower[max_height];
+		link *heads[max_height];
+		link *below = nullptr;
+		int built = 1;
+		int added = 0;
+		int level;
+
+		try {
+			for(; built < height; ++built) {
+				tower[built] = _make_link();
+			}
+			for(; _levels + added < height; ++added) {
+				heads[added] = _make_link();
+			}
+		} catch(...) {
+			while(built > 1) {
+				_free_link(tower[--built]);
+			}
+			while(added > 0) {
+				_free_link(heads[--added]);
+			}
+			throw;
+		}
+		tower[0] = new_node;
+
+		// sublists added on top start out empty
+		for(level = 0; level < added; ++level) {
+			heads[level]->_down = _top;
+			_top->_up = heads[level];
+			_top = heads[level];
+			preds[_levels++] = _top;
+		}
+
+		for(level = 0; level < height; ++level) {
+			tower[level]->_base = new_node;
+			tower[level]->_down = below;
+			if(below) {
+				below->_up = tower[level];
+			}
+			tower[level]->_prev = preds[level];
+			tower[level]->_next = preds[level]->_next;
+			if(preds[level]->_next) {
+				preds[level]->_next->_prev = tower[level];
+			}
+			preds[level]->_next = tower[level];
+			below = tower[level];
+		}
+
+		if(!new_node->_next) {
+			_last = new_node;
+		}
+		++_size;
+	}
+
+	/*
+	* Removes empty sublists from the top, like _reduce_height().
+	*/
+	void _reduce_height() noexcept {
+		link *below;
+
+		while(_levels > 1 && !_top->_next) {
+			below = _top->_down;
+			_free_link(_top);
+			below->_up = nullptr;
+			_top = below;
+			--_levels;
+		}
+	}
+
+	/*
+	* Finds the last node of every level, l0 first, for _append().
+	*/
+	void _find_tails(link **tails) {
+		link *current_node;
+		int level;
+
+		_ensure_head();
+		current_node = _top;
+		for(level = _levels - 1; level >= 0; --level) {
+			while(current_node->_next) {
+				current_node = current_node->_next;
+			}
+			tails[level] = current_node;
+			current_node = current_node->_down;
+		}
+	}
+
+	/*
+	* Appends an element not less than the last one to the end of the list
+	* in O(1) expected time, like _builder_append(), and moves tails to the
+	* new tower.
+	*/
+	template<class... Args>
+	void _append(link **tails, Args &&...args) {
+		node_type *new_node = _create_node(std::forward<Args>(args)...);
+		link *current_node;
+		int level = 0;
+
+		try {
+			_link_node(new_node, tails, _random_height());
+		} catch(...) {
+			_destroy_node(new_node);
+			throw;
+		}
+		for(current_node = new_node; current_node; current_node = current_node->_up) {
+			tails[level++] = current_node;
+		}
+	}
+
+	template<class InputIt>
+	void _append_all(InputIt first, InputIt last) {
+		link *tails[max_height];
+
+		if(first == last) {
+			return;
+		}
+		_find_tails(tails);
+		for(; first != last; ++first) {
+			_append(tails, *first);
+		}
+	}
+
+	/*
+	* Moves the elements of a list whose nodes this list cannot take over,
+	* because they come from an allocator that does not compare equal.
+	*/
+	void _move_all(skip_list_impl &other) {
+		link *tails[max_height];
+		link *current_node;
+
+		if(other.empty()) {
+			return;
+		}
+		_find_tails(tails);
+		for(current_node = other._base->_next; current_node; current_node = current_node->_next) {
+			_append(tails, std::move(static_cast<node_type *>(current_node)->value()));
+		}
+		other.clear();
+	}
+
+	void _steal(skip_list_impl &other) noexcept {
+		_top = other._top;
+		_base = other._base;
+		_last = other._last;
+		_levels = other._levels;
+		_size = other._size;
+		other._top = other._base = other._last = nullptr;
+		other._levels = 0;
+		other._size = 0;
+	}
+
+	Compare _comp;
+	Allocator _alloc;
+	std::uint64_t _seed;
+	link *_top = nullptr;	// header of the top sublist, nullptr until the first insert
+	link *_base = nullptr;	// header of l0
+	link *_last = nullptr;	// last node of l0, nullptr when empty
+	int _levels = 0;
+	size_type _size = 0;
+};
+
+} // namespace detail
+
+/* SkipList
+* An ordered set of unique keys with the interface of std::set. Iterators are
+* constant, as changing an element could break the order.
+*/
+
+template<class Key, class Compare = std::less<Key>, class Allocator = std::allocator<Key>>
+class SkipList : public detail::skip_list_impl<Key, detail::identity_key, Compare, Allocator, true> {
+	using impl = detail::skip_list_impl<Key, detail::identity_key, Compare, Allocator, true>;
+
+public:
+	using impl::impl;
+
+	SkipList &operator=(std::initializer_list<Key> values) {
+		impl::operator=(values);
+		return *this;
+	}
+};
+
+/* SkipMap
+* An ordered map of unique keys with the interface of std::map.
+*/
+
+template<class Key, class T, class Compare = std::less<Key>, class Allocator = std::allocator<std::pair<const Key, T>>>
+class SkipMap : public detail::skip_list_impl<std::pair<const Key, T>, detail::select_first, Compare, Allocator, false> {
+	using impl = detail::skip_list_impl<std::pair<const Key, T>, detail::select_first, Compare, Allocator, false>;
+
+public:
+	using mapped_type = T;
+	using typename impl::key_type;
+	using typename impl::value_type;
+	using typename impl::iterator;
+	using typename impl::const_iterator;
+	using impl::impl;
+	using impl::insert;
+
+	SkipMap &operator=(std::initializer_list<value_type> values) {
+		impl::operator=(values);
+		return *this;
+	}
+
+	template<class P, class = std::enable_if_t<std::is_constructible_v<value_type, P &&>>>
+	std::pair<iterator, bool> insert(P &&value) {
+		return this->emplace(std::forward<P>(value));
+	}
+
+	/*
+	* Searches before constructing anything, so an element is only built
+	* when the key is missing, and args are left untouched otherwise.
+	*/
+	template<class... Args>
+	std::pair<iterator, bool> try_emplace(const key_type &key, Args &&...args) {
+		return _try_emplace(key, std::forward<Args>(args)...);
+	}
+	template<class... Args>
+	std::pair<iterator, bool> try_emplace(key_type &&key, Args &&...args) {
+		return _try_emplace(std::move(key), std::forward<Args>(args)...);
+	}
+
+	template<class M>
+	std::pair<iterator, bool> insert_or_assign(const key_type &key, M &&mapped) {
+		std::pair<iterator, bool> result = try_emplace(key, std::forward<M>(mapped));
+
+		if(!result.second) {
+			result.first->second = std::forward<M>(mapped);
+		}
+		return result;
+	}
+	template<class M>
+	std::pair<iterator, bool> insert_or_assign(key_type &&key, M &&mapped) {
+		std::pair<iterator, bool> result = try_emplace(std::move(key), std::forward<M>(mapped));
+
+		if(!result.second) {
+			result.first->second = std::forward<M>(mapped);
+		}
+		return result;
+	}
+
+	T &operator[](const key_type &key) {
+		return try_emplace(key).first->second;
+	}
+	T &operator[](key_type &&key) {
+		return try_emplace(std::move(key)).first->second;
+	}
+
+	T &at(const key_type &key) {
+		iterator pos = this->find(key);
+
+		if(pos == this->end()) {
+			throw std::out_of_range("SkipMap::at");
+		}
+		return pos->second;
+	}
+	const T &at(const key_type &key) const {
+		const_iterator pos = this->find(key);
+
+		if(pos == this->end()) {
+			throw std::out_of_range("SkipMap::at");
+		}
+		return pos->second;
+	}
+
+private:
+	template<class K, class... Args>
+	std::pair<iterator, bool> _try_emplace(K &&key, Args &&...args) {
+		detail::link *preds[impl::max_height];
+		detail::link *prev_node;
+		typename impl::node_type *new_node;
+
+		this->_ensure_head();
+		prev_node = this->_find_previous(key, preds);
+		if(prev_node->_next && !this->_comp(key, impl::_key(prev_node->_next))) {
+			return {this->_make_iterator(prev_node->_next), false};
+		}
+
+		new_node = this->_create_node(std::piecewise_construct,
+				std::forward_as_tuple(std::forward<K>(key)),
+				std::forward_as_tuple(std::forward<Args>(args)...));
+		try {
+			this->_link_node(new_node, preds, this->_random_height());
+		} catch(...) {
+			this->_destroy_node(new_node);
+			throw;
+		}
+
+		return {this->_make_iterator(new_node), true};
+	}
+};
+
+/* pmr::SkipList, pmr::SkipMap
+* The containers on a std::pmr::polymorphic_allocator, so that the nodes of a
+* list come from any std::pmr::memory_resource, such as a monotonic buffer for
+* request-scoped lists or a pool shared by many lists. Elements that use a
+* polymorphic allocator themselves, like std::pmr::string, are given the same
+* resource when they are constructed in their node.
+*/
+
+#if __has_include(<memory_resource>)
+
+namespace pmr {
+
+template<class Key, class Compare = std::less<Key>>
+using SkipList = skiplist::SkipList<Key, Compare, std::pmr::polymorphic_allocator<Key>>;
+
+template<class Key, class T, class Compare = std::less<Key>>
+using SkipMap = skiplist::SkipMap<Key, T, Compare, std::pmr::polymorphic_allocator<std::pair<const Key, T>>>;
+
+} // namespace pmr
+
+#endif
+
+} // namespace skiplist
+
+#endif
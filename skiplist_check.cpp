@@ -0,0 +1,534 @@
+
+/*
+* File: 	skiplist_check.cpp
+* Description:	Randomized checks of the C++ containers in skiplist.hpp, the
+*		counterpart of ./skiplist check for skiplist.c. Every check
+*		runs the containers against std::set or std::map and reports
+*		the first difference. Build and run it with
+*
+*		g++ -std=c++17 -Wall -Wextra -O2 skiplist_check.cpp -o skiplist_check
+*		./skiplist_check [rounds] [seed]
+*/
+
+#include "skiplist.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <map>
+#include <random>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/* check_alloc
+* An allocator that counts the blocks it has handed out and throws
+* std::bad_alloc once the countdown in its state reaches zero. Copies share
+* the state, and allocators with different states do not compare equal, so
+* moving between them has to move the elements one by one.
+*/
+
+struct check_state {
+	long live = 0;
+	long countdown = -1;	// allocations left before one throws, -1 for never
+};
+
+template<class T>
+struct check_alloc {
+	using value_type = T;
+	using propagate_on_container_move_assignment = std::false_type;
+	using is_always_equal = std::false_type;
+
+	check_state *state;
+
+	explicit check_alloc(check_state *s) noexcept : state(s) {}
+	template<class U>
+	check_alloc(const check_alloc<U> &other) noexcept : state(other.state) {}
+
+	T *allocate(std::size_t n) {
+		if(state->countdown == 0) {
+			throw std::bad_alloc();
+		}
+		if(state->countdown > 0) {
+			--(state->countdown);
+		}
+		++(state->live);
+		return static_cast<T *>(::operator new(n * sizeof(T)));
+	}
+	void deallocate(T *ptr, std::size_t) noexcept {
+		--(state->live);
+		::operator delete(ptr);
+	}
+
+	template<class U>
+	bool operator==(const check_alloc<U> &other) const noexcept {
+		return state == other.state;
+	}
+	template<class U>
+	bool operator!=(const check_alloc<U> &other) const noexcept {
+		return state != other.state;
+	}
+};
+
+/* thrower
+* A key whose constructor throws once the countdown reaches zero, and that
+* counts the instances alive so leaked elements show up.
+*/
+
+struct thrower {
+	static long countdown;
+	static long live;
+	int key;
+
+	explicit thrower(int k) : key(k) {
+		if(countdown == 0) {
+			throw std::runtime_error("thrower");
+		}
+		if(countdown > 0) {
+			--countdown;
+		}
+		++live;
+	}
+	thrower(const thrower &other) : thrower(other.key) {}
+	~thrower() {
+		--live;
+	}
+	bool operator<(const thrower &other) const noexcept {
+		return key < other.key;
+	}
+	bool operator==(const thrower &other) const noexcept {
+		return key == other.key;
+	}
+};
+
+long thrower::countdown = -1;
+long thrower::live = 0;
+
+/* counted, counted_less
+* A key that counts how often it is constructed, and a transparent comparator
+* that compares it with plain ints, so lookups by int must not build one.
+*/
+
+struct counted {
+	static long made;
+	int key;
+
+	explicit counted(int k) : key(k) {
+		++made;
+	}
+	counted(const counted &other) : key(other.key) {
+		++made;
+	}
+};
+
+long counted::made = 0;
+
+struct counted_less {
+	using is_transparent = void;
+
+	bool operator()(const counted &a, const counted &b) const noexcept {
+		return a.key < b.key;
+	}
+	bool operator()(const counted &a, int b) const noexcept {
+		return a.key < b;
+	}
+	bool operator()(int a, const counted &b) const noexcept {
+		return a < b.key;
+	}
+};
+
+/* move_only
+* A key that can only be moved, ordered by the int it owns.
+*/
+
+struct move_only {
+	std::unique_ptr<int> key;
+
+	explicit move_only(int k) : key(std::make_unique<int>(k)) {}
+	bool operator<(const move_only &other) const noexcept {
+		return *key < *(other.key);
+	}
+};
+
+/* value_of
+* Reads what check_same() compares out of the elements of a list and its model.
+*/
+
+int value_of(int value) {
+	return value;
+}
+
+int value_of(const move_only &value) {
+	return *(value.key);
+}
+
+int value_of(const thrower &value) {
+	return value.key;
+}
+
+template<class T>
+int value_of(const std::pair<const int, T> &value) {
+	return value.first;
+}
+
+std::string_view value_of(std::string_view value) {
+	return value;
+}
+
+/*
+* Returns 1 and reports what when the elements of list differ from the ones of
+* model, walking forward and backward.
+*/
+template<class List, class Model>
+int check_same(const List &list, const Model &model, const char *what, int round) {
+	auto model_node = model.begin();
+	auto model_back = model.rbegin();
+
+	if(list.size() != model.size() || list.empty() != model.empty()) {
+		printf("%s: size %zu instead of %zu in round %d\n", what, list.size(), model.size(), round);
+		return 1;
+	}
+	for(auto current = list.begin(); current != list.end(); ++current, ++model_node) {
+		if(value_of(*current) != value_of(*model_node)) {
+			printf("%s: wrong element walking forward in round %d\n", what, round);
+			return 1;
+		}
+	}
+	for(auto current = list.rbegin(); current != list.rend(); ++current, ++model_back) {
+		if(value_of(*current) != value_of(*model_back)) {
+			printf("%s: wrong element walking backward in round %d\n", what, round);
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+/*
+* Inserts, erases and searches random keys in a SkipList and a std::set,
+* through the allocator above, then copies, moves and swaps the list. Every
+* block must be back once the lists are gone.
+*/
+int check_set(std::mt19937 &rng, int rounds) {
+	using list_type = skiplist::SkipList<int, std::less<int>, check_alloc<int>>;
+	check_state state;
+	std::set<int> model;
+	int failed = 0;
+
+	{
+		list_type list{check_alloc<int>(&state)};
+
+		for(int round = 0; round < rounds && !failed; ++round) {
+			int k = static_cast<int>(rng() % 512);
+			auto expect = model.lower_bound(k);
+			auto found = list.lower_bound(k);
+
+			if((found == list.end()) != (expect == model.end()) || (found != list.end() && *found != *expect) ||
+					(list.upper_bound(k) == list.end()) != (model.upper_bound(k) == model.end()) ||
+					list.contains(k) != !!model.count(k) || list.count(k) != model.count(k)) {
+				printf("set: search for %d wrong in round %d\n", k, round);
+				failed = 1;
+				break;
+			}
+
+			switch(rng() % 6) {
+			case 0:
+				failed |= list.insert(k).second != model.insert(k).second;
+				break;
+			case 1:
+				// the hint is right for one key in two
+				list.emplace_hint(rng() % 2 ? found : list.begin(), k);
+				model.insert(k);
+				break;
+			case 2:
+				failed |= list.erase(k) != model.erase(k);
+				break;
+			case 3:
+				if(found != list.end()) {
+					auto next = list.erase(found);
+					expect = model.erase(expect);
+					failed |= (next == list.end()) != (expect == model.end()) || (next != list.end() && *next != *expect);
+				}
+				break;
+			case 4:
+				// erase a short range
+				if(found != list.end()) {
+					auto last = found;
+					auto model_last = expect;
+					for(int steps = 0; steps < 3 && last != list.end(); ++steps, ++last, ++model_last);
+					list.erase(found, last);
+					model.erase(expect, model_last);
+				}
+				break;
+			default:
+				if(rng() % 64 == 0) {
+					list.clear();
+					model.clear();
+				}
+			}
+			failed |= check_same(list, model, "set", round);
+		}
+
+		list_type copy(list);
+		list_type moved(std::move(copy));
+		list_type other({1, 2, 3}, check_alloc<int>(&state));
+
+		failed |= check_same(moved, model, "set copy", rounds) || !copy.empty() || !(moved == list);
+		other.swap(moved);
+		failed |= check_same(other, model, "set swap", rounds) || moved.size() != 3;
+		moved = other;
+		failed |= check_same(moved, model, "set assignment", rounds);
+	}
+	if(state.live) {
+		printf("set: %ld blocks left after the lists were destroyed\n", state.live);
+		failed = 1;
+	}
+
+	return failed;
+}
+
+/*
+* A SkipMap with move-only values against a std::map, through try_emplace,
+* insert_or_assign, operator[] and at().
+*/
+int check_map(std::mt19937 &rng, int rounds) {
+	skiplist::SkipMap<int, std::unique_ptr<int>> map;
+	std::map<int, int> model;
+	int failed = 0;
+
+	for(int round = 0; round < rounds && !failed; ++round) {
+		int k = static_cast<int>(rng() % 256);
+		auto value = std::make_unique<int>(round);
+
+		switch(rng() % 4) {
+		case 0:
+			// a key that is already there leaves the value alone
+			failed |= map.try_emplace(k, std::move(value)).second != model.emplace(k, round).second;
+			failed |= !model.count(k) || (model[k] != round) != !!value;
+			break;
+		case 1:
+			map.insert_or_assign(k, std::move(value));
+			model[k] = round;
+			break;
+		case 2:
+			map[k] = std::make_unique<int>(round);
+			model[k] = round;
+			break;
+		default:
+			failed |= map.erase(k) != model.erase(k);
+		}
+
+		try {
+			failed |= *(map.at(k)) != model.at(k);
+		} catch(const std::out_of_range &) {
+			failed |= !!model.count(k) || !!map.count(k);
+		}
+		if(failed) {
+			printf("map: key %d wrong in round %d\n", k, round);
+			break;
+		}
+		failed |= check_same(map, model, "map", round);
+	}
+	for(auto &pair : map) {
+		if(*(pair.second) != model[pair.first]) {
+			printf("map: value of key %d wrong\n", pair.first);
+			failed = 1;
+			break;
+		}
+	}
+
+	return failed;
+}
+
+/*
+* A SkipList of keys that can only be moved, moved as a whole into new lists
+* and swapped.
+*/
+int check_move_only(std::mt19937 &rng, int rounds) {
+	skiplist::SkipList<move_only> list;
+	std::set<int> model;
+	int failed = 0;
+
+	for(int round = 0; round < rounds / 4; ++round) {
+		int k = static_cast<int>(rng() % 1024);
+
+		failed |= list.emplace(k).second != model.insert(k).second;
+	}
+
+	skiplist::SkipList<move_only> moved(std::move(list));
+	skiplist::SkipList<move_only> other;
+
+	other.emplace(-1);
+	other = std::move(moved);
+	swap(list, other);
+	failed |= !other.empty() || !moved.empty() || list.size() != model.size();
+	failed |= check_same(list, model, "move only", rounds);
+
+	return failed;
+}
+
+/*
+* Inserts while constructors and allocations throw at random. A failed insert
+* must leave the list as it was and free everything it allocated, and so must
+* a copy that fails half way.
+*/
+int check_throwing(std::mt19937 &rng, int rounds) {
+	using list_type = skiplist::SkipList<thrower, std::less<thrower>, check_alloc<thrower>>;
+	check_state state;
+	std::set<int> model;
+	int failed = 0;
+
+	{
+		list_type list{check_alloc<thrower>(&state)};
+
+		for(int round = 0; round < rounds && !failed; ++round) {
+			int k = static_cast<int>(rng() % 512);
+			long blocks = state.live;
+			bool thrown = false;
+
+			thrower::countdown = rng() % 4 ? -1 : static_cast<long>(rng() % 2);
+			state.countdown = rng() % 4 ? -1 : static_cast<long>(rng() % 4);
+			try {
+				if(rng() % 2) {
+					list.emplace(k);
+				} else {
+					list.insert(list.lower_bound(thrower(k)), thrower(k));
+				}
+				model.insert(k);
+			} catch(const std::exception &) {
+				thrown = true;
+			}
+			thrower::countdown = -1;
+			state.countdown = -1;
+
+			if(thrown && state.live != blocks) {
+				printf("throwing: %ld blocks leaked by a failed insert in round %d\n", state.live - blocks, round);
+				failed = 1;
+			}
+			if(rng() % 8 == 0) {
+				failed |= list.erase(thrower(k)) != model.erase(k);
+			}
+			failed |= check_same(list, model, "throwing", round);
+			failed |= thrower::live != static_cast<long>(list.size());
+		}
+
+		// a copy that throws half way frees what it built
+		long blocks = state.live;
+
+		thrower::countdown = static_cast<long>(list.size() / 2);
+		try {
+			list_type copy(list);
+			failed |= list.size() > 1;
+		} catch(const std::exception &) {
+		}
+		thrower::countdown = -1;
+		if(state.live != blocks || thrower::live != static_cast<long>(list.size())) {
+			printf("throwing: a failed copy leaked\n");
+			failed = 1;
+		}
+	}
+	if(state.live || thrower::live) {
+		printf("throwing: %ld blocks and %ld elements left after the list was destroyed\n", state.live, thrower::live);
+		failed = 1;
+	}
+
+	return failed;
+}
+
+/*
+* pmr lists of pmr strings: the strings must live on the resource of their
+* list, also after the list is moved to a different resource.
+*/
+int check_pmr(std::mt19937 &rng, int rounds) {
+	int failed = 0;
+#if __has_include(<memory_resource>)
+	std::pmr::monotonic_buffer_resource buffer;
+	std::pmr::unsynchronized_pool_resource pool;
+	skiplist::pmr::SkipList<std::pmr::string> list(&buffer);
+	std::set<std::string> model;
+
+	for(int round = 0; round < rounds / 4; ++round) {
+		// long enough not to fit in the string itself
+		std::string k = "a string longer than the small buffer " + std::to_string(rng() % 1024);
+
+		list.emplace(k);
+		model.insert(k);
+	}
+	for(const auto &value : list) {
+		failed |= value.get_allocator().resource() != &buffer;
+	}
+
+	skiplist::pmr::SkipList<std::pmr::string> moved(std::move(list), &pool);
+
+	for(const auto &value : moved) {
+		failed |= value.get_allocator().resource() != &pool;
+	}
+	if(failed) {
+		printf("pmr: an element is not on the resource of its list\n");
+	}
+	failed |= check_same(moved, model, "pmr", rounds) || !list.empty();
+#else
+	(void)rng;
+	(void)rounds;
+#endif
+
+	return failed;
+}
+
+/*
+* Lookups by int in a list of counted keys with a transparent comparator must
+* find the same keys as std::set does and never build a key to compare with.
+*/
+int check_transparent(std::mt19937 &rng, int rounds) {
+	skiplist::SkipList<counted, counted_less> list;
+	std::set<int> model;
+	long made;
+	int failed = 0;
+
+	for(int round = 0; round < rounds / 4; ++round) {
+		int k = static_cast<int>(rng() % 1024);
+
+		list.emplace(k);
+		model.insert(k);
+	}
+
+	made = counted::made;
+	for(int k = -1; k <= 1024 && !failed; ++k) {
+		auto range = list.equal_range(k);
+		auto lower = model.lower_bound(k);
+
+		failed |= list.contains(k) != !!model.count(k) || list.count(k) != model.count(k);
+		failed |= (list.find(k) != list.end()) != !!model.count(k);
+		failed |= (range.first == list.end()) != (lower == model.end()) || (range.first != list.end() && range.first->key != *lower);
+		failed |= std::distance(range.first, range.second) != static_cast<long>(model.count(k));
+		failed |= (list.upper_bound(k) == list.end()) != (model.upper_bound(k) == model.end());
+		if(failed) {
+			printf("transparent: lookup of %d wrong\n", k);
+		}
+	}
+	if(!failed && counted::made != made) {
+		printf("transparent: lookups built %ld keys\n", counted::made - made);
+		failed = 1;
+	}
+
+	return failed;
+}
+
+int main(int argc, char **argv) {
+	int rounds = argc > 1 ? atoi(argv[1]) : 20000;
+	unsigned int seed = argc > 2 ? (unsigned int)atoi(argv[2]) : (unsigned int)time(NULL);
+	std::mt19937 rng(seed);
+	int failed = 0;
+
+	printf("seed %u\n", seed);
+	failed |= check_set(rng, rounds);
+	failed |= check_map(rng, rounds);
+	failed |= check_move_only(rng, rounds);
+	failed |= check_throwing(rng, rounds);
+	failed |= check_pmr(rng, rounds);
+	failed |= check_transparent(rng, rounds);
+	printf(failed ? "FAILED\n" : "ok\n");
+
+	return failed;
+}